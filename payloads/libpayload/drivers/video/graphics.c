@@ -43,6 +43,10 @@ static struct rect screen;
 
 static uint8_t *gfx_buffer;
 
+/* Framebuffer rows touched in gfx_buffer since the last flush. */
+static int dirty_first_row;
+static int dirty_last_row = -1;
+
 /*
  * Framebuffer is assumed to assign a higher coordinate (larger x, y) to
  * a higher address
@@ -270,6 +274,14 @@ static inline uint32_t calculate_color(const struct rgb_color *rgb,
 	return color;
 }
 
+static inline void mark_dirty_rows(int first, int last)
+{
+	if (first < dirty_first_row)
+		dirty_first_row = first;
+	if (last > dirty_last_row)
+		dirty_last_row = last;
+}
+
 /*
  * Plot a pixel in a framebuffer. This is called from tight loops. Keep it slim
  * and do the validation at callers' site.
@@ -302,6 +314,16 @@ static inline void set_pixel(struct vector *coord, uint32_t color)
 	}
 
 	uint8_t * const pixel = FB + rcoord.y * bpl + rcoord.x * bpp / 8;
+
+	if (gfx_buffer)
+		mark_dirty_rows(rcoord.y, rcoord.y);
+
+	/* One store instead of four, the framebuffer is usually uncached. */
+	if (bpp == 32 && !((uintptr_t)pixel & 3)) {
+		*(uint32_t *)pixel = color;
+		return;
+	}
+
 	for (i = 0; i < bpp / 8; i++)
 		pixel[i] = (color >> (i * 8));
 }
@@ -630,6 +652,8 @@ int clear_screen(const struct rgb_color *rgb)
 	if ((((color >> 8) & 0xff) == (color & 0xff)) && (bpp == 16 ||
 	    (((color >> 16) & 0xff) == (color & 0xff)))) {
 		memset(FB, color & 0xff, fbinfo->y_resolution * bpl);
+		if (gfx_buffer)
+			mark_dirty_rows(0, fbinfo->y_resolution - 1);
 	} else {
 		for (p.y = 0; p.y < screen.size.height; p.y++)
 			for (p.x = 0; p.x < screen.size.width; p.x++)
@@ -1277,6 +1301,10 @@ int enable_graphics_buffer(void)
 		return CBGFX_ERROR_GRAPHICS_BUFFER;
 	}
 
+	/* The whole buffer is written out on the first flush. */
+	dirty_first_row = 0;
+	dirty_last_row = fbinfo->y_resolution - 1;
+
 	return CBGFX_SUCCESS;
 }
 
@@ -1285,7 +1313,17 @@ int flush_graphics_buffer(void)
 	if (!gfx_buffer)
 		return CBGFX_ERROR_GRAPHICS_BUFFER;
 
-	memcpy(REAL_FB, gfx_buffer, fbinfo->y_resolution * fbinfo->bytes_per_line);
+	const int bpl = fbinfo->bytes_per_line;
+
+	/* Only copy the rows that were drawn to since the last flush. */
+	if (dirty_first_row <= dirty_last_row)
+		memcpy(REAL_FB + dirty_first_row * bpl,
+		       gfx_buffer + dirty_first_row * bpl,
+		       (dirty_last_row - dirty_first_row + 1) * bpl);
+
+	dirty_first_row = fbinfo->y_resolution;
+	dirty_last_row = -1;
+
 	return CBGFX_SUCCESS;
 }
 
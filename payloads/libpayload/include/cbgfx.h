@@ -285,7 +285,7 @@ int enable_graphics_buffer(void);
 
 /**
  * Redraw buffered graphics data to real screen if graphics buffer is already
- * enabled.
+ * enabled. Only the rows drawn to since the last flush are copied.
  *
  * @return CBGFX_* error codes
  */
@@ -13,7 +13,7 @@ typedef __SIZE_TYPE__ size_t;
 typedef __SIZE_TYPE__ ssize_t;
 #undef unsigned
 
-#define offsetof(TYPE, MEMBER)	((size_t) &((TYPE *) 0)->MEMBER)
+#define offsetof(TYPE, MEMBER)	__builtin_offsetof(TYPE, MEMBER)
 #define member_size(TYPE, MEMBER)	(sizeof(((TYPE *) 0)->MEMBER))
 
 #define check_member(structure, member, offset) _Static_assert( \
@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-only */
+
+#ifndef __ZSTD_H_
+#define __ZSTD_H_
+
+#include <stddef.h>
+
+/* Decompresses a Zstandard frame from src to dst, ensuring that it doesn't
+ * read more than srcn bytes and doesn't write more than dstn. The decoding
+ * context is allocated from the heap for the duration of the call.
+ * Returns amount of decompressed bytes, or 0 on error.
+ */
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn);
+
+#endif /* __ZSTD_H_ */
@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-only */
+
+#include <libpayload.h>
+#include <zstd.h>
+
+/* The decoder sources are shared with coreboot proper, see
+ * src/commonlib/bsd/zstd_wrapper.c for the configuration used here. */
+#define DEBUGLEVEL 0
+#define ZSTD_LEGACY_SUPPORT 0
+#define ZSTD_STRIP_ERROR_STRINGS
+#define ZSTD_NO_TRACE
+#define ZSTD_DISABLE_ASM 1
+#define DYNAMIC_BMI2 0
+#define ZSTD_NO_INTRINSICS
+#undef XXH_NAMESPACE
+#define XXH_NAMESPACE ZSTD_
+#define XXH_PRIVATE_API
+#define XXH_INLINE_ALL
+#define XXH_NO_STDLIB
+#define ZSTD_STATIC_LINKING_ONLY
+
+#include "../../../src/commonlib/bsd/zstd/common/debug.c"
+#include "../../../src/commonlib/bsd/zstd/common/entropy_common.c"
+#include "../../../src/commonlib/bsd/zstd/common/error_private.c"
+#include "../../../src/commonlib/bsd/zstd/common/fse_decompress.c"
+#include "../../../src/commonlib/bsd/zstd/common/zstd_common.c"
+#include "../../../src/commonlib/bsd/zstd/decompress/huf_decompress.c"
+#include "../../../src/commonlib/bsd/zstd/decompress/zstd_ddict.c"
+#include "../../../src/commonlib/bsd/zstd/decompress/zstd_decompress.c"
+#include "../../../src/commonlib/bsd/zstd/decompress/zstd_decompress_block.c"
+
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	ZSTD_DCtx *dctx;
+	void *space;
+	size_t ret = 0;
+
+	space = malloc(sizeof(ZSTD_DCtx));
+	if (!space)
+		return 0;
+
+	dctx = ZSTD_initStaticDCtx(space, sizeof(ZSTD_DCtx));
+	if (dctx) {
+		ret = ZSTD_decompressDCtx(dctx, dst, dstn, src, srcn);
+		if (ZSTD_isError(ret))
+			ret = 0;
+	}
+
+	free(space);
+	return ret;
+}
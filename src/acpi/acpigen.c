@@ -10,6 +10,7 @@
 
 #define ACPIGEN_MAXLEN 0xfffff
 
+#include <commonlib/endian.h>
 #include <lib.h>
 #include <string.h>
 #include <acpi/acpigen.h>
@@ -71,16 +72,14 @@ void acpigen_emit_ext_op(uint8_t op)
 
 void acpigen_emit_word(unsigned int data)
 {
-	acpigen_emit_byte(data & 0xff);
-	acpigen_emit_byte((data >> 8) & 0xff);
+	write_le16(gencurrent, data);
+	gencurrent += 2;
 }
 
 void acpigen_emit_dword(unsigned int data)
 {
-	acpigen_emit_byte(data & 0xff);
-	acpigen_emit_byte((data >> 8) & 0xff);
-	acpigen_emit_byte((data >> 16) & 0xff);
-	acpigen_emit_byte((data >> 24) & 0xff);
+	write_le32(gencurrent, data);
+	gencurrent += 4;
 }
 
 char *acpigen_write_package(int nr_el)
@@ -208,9 +207,10 @@ void acpigen_write_name_unicode(const char *name, const char *string)
 
 void acpigen_emit_stream(const char *data, int size)
 {
-	int i;
-	for (i = 0; i < size; i++)
-		acpigen_emit_byte(data[i]);
+	if (size <= 0)
+		return;
+	memcpy(gencurrent, data, size);
+	gencurrent += size;
 }
 
 void acpigen_emit_string(const char *string)
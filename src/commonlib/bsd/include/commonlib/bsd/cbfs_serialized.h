@@ -13,6 +13,7 @@
 #define CBFS_COMPRESS_NONE  0
 #define CBFS_COMPRESS_LZMA  1
 #define CBFS_COMPRESS_LZ4   2
+#define CBFS_COMPRESS_ZSTD  3
 
 /** These are standard component types for well known
     components (i.e - those that coreboot needs to consume.
@@ -115,6 +116,7 @@ struct cbfs_file_attribute {
 #define CBFS_FILE_ATTR_TAG_POSITION 0x42435350  /* PSCB */
 #define CBFS_FILE_ATTR_TAG_ALIGNMENT 0x42434c41 /* ALCB */
 #define CBFS_FILE_ATTR_TAG_IBB 0x32494242 /* Initial BootBlock */
+#define CBFS_FILE_ATTR_TAG_INPLACE 0x42435049 /* IPCB */
 
 struct cbfs_file_attr_compression {
 	uint32_t tag;
@@ -144,6 +146,15 @@ struct cbfs_file_attr_align {
 	uint32_t alignment;
 } __packed;
 
+/* Compressed stages can be decompressed in place when their data is loaded to
+   the end of a buffer that is at least decompressed_size + margin bytes. */
+struct cbfs_file_attr_inplace {
+	uint32_t tag;
+	uint32_t len;
+	uint32_t decompressed_size;
+	uint32_t margin;
+} __packed;
+
 
 /*** Component sub-headers ***/
 
@@ -18,4 +18,20 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn);
 /* Same as ulz4fn() but does not perform any bounds checks. */
 size_t ulz4f(const void *src, void *dst);
 
+/* Compresses srcn bytes from src into an LZ4F image at dst that ulz4fn() can
+ * decompress, writing no more than dstn bytes. Uses a simple greedy matcher
+ * that favors speed over ratio, for caching data at runtime. If dst is NULL,
+ * nothing is written and only the size of the image is computed. Uses 16KiB
+ * of .bss. Returns the size of the compressed image, or 0 on error.
+ */
+size_t clz4fn(const void *src, size_t srcn, void *dst, size_t dstn);
+
+/* Decompresses a single Zstandard frame from src to dst, ensuring that it
+ * doesn't read more than srcn bytes and doesn't write more than dstn. Can
+ * decompress in place if src is at the end of the dst buffer and the buffer
+ * exceeds the output size by the margin cbfstool records for stages.
+ * Returns amount of decompressed bytes, or 0 on error.
+ */
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn);
+
 #endif	/* _COMMONLIB_COMPRESSION_H_ */
@@ -48,6 +48,16 @@ static void LZ4_copy8(void *dst, const void *src)
 #endif
 }
 
+/* Used by the decoder shortcut for short literal runs and matches. Splitting
+ * it into two 8-byte moves keeps the unaligned access workarounds above, while
+ * the compiler is still free to fuse them into a single 16-byte load/store pair
+ * on architectures where that is safe (e.g. LDP/STP on ARM64). */
+static void LZ4_copy16(void *dst, const void *src)
+{
+	LZ4_copy8(dst, src);
+	LZ4_copy8(dst + 8, src + 8);
+}
+
 typedef  uint8_t BYTE;
 typedef uint16_t U16;
 typedef uint32_t U32;
@@ -58,7 +68,8 @@ typedef uint64_t U64;
 #define likely(expr) __builtin_expect((expr) != 0, 1)
 #define unlikely(expr) __builtin_expect((expr) != 0, 0)
 
-/* Unaltered (just removed unrelated code) from github.com/Cyan4973/lz4/dev. */
+/* Unaltered (just removed unrelated code) from github.com/Cyan4973/lz4/dev,
+ * except for the decoder shortcut backported from LZ4 v1.8.2. */
 #include "lz4.c.inc"	/* #include for inlining, do not link! */
 
 #define LZ4F_MAGICNUMBER 0x184D2204
@@ -175,3 +186,220 @@ size_t ulz4f(const void *src, void *dst)
 	/* LZ4 uses signed size parameters, so can't just use ((u32)-1) here. */
 	return ulz4fn(src, 1*GiB, dst, 1*GiB);
 }
+
+/* A minimal greedy LZ4 block compressor in the spirit of LZ4_compress_fast(),
+ * which was not imported with the decoder. */
+#define LZ4_HASH_LOG 12
+#define LZ4F_MAX_BLOCK_SIZE (4 * MiB)
+
+static uint32_t LZ4_read32(const void *src)
+{
+	uint32_t val;
+	memcpy(&val, src, sizeof(val));
+	return val;
+}
+
+static uint32_t LZ4_hash4(uint32_t seq)
+{
+	return (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/* Writes one sequence (a literal run, then a match unless offset is 0) to op
+ * and returns its size. If op is NULL, only the size is returned. */
+static size_t lz4_emit_sequence(BYTE *op, const BYTE *lit, size_t lit_len,
+				size_t offset, size_t match_len)
+{
+	size_t size = 1 + lit_len;
+	BYTE *token = op;
+
+	if (lit_len >= RUN_MASK)
+		size += (lit_len - RUN_MASK) / 255 + 1;
+	if (offset) {
+		size += 2;
+		if (match_len >= ML_MASK)
+			size += (match_len - ML_MASK) / 255 + 1;
+	}
+	if (!op)
+		return size;
+
+	op++;
+	if (lit_len >= RUN_MASK) {
+		size_t len = lit_len - RUN_MASK;
+		*token = RUN_MASK << ML_BITS;
+		for (; len >= 255; len -= 255)
+			*op++ = 255;
+		*op++ = len;
+	} else {
+		*token = lit_len << ML_BITS;
+	}
+	memcpy(op, lit, lit_len);
+	op += lit_len;
+
+	if (offset) {
+		*op++ = offset & 0xff;
+		*op++ = offset >> 8;
+		if (match_len >= ML_MASK) {
+			size_t len = match_len - ML_MASK;
+			*token |= ML_MASK;
+			for (; len >= 255; len -= 255)
+				*op++ = 255;
+			*op++ = len;
+		} else {
+			*token |= match_len;
+		}
+	}
+
+	return size;
+}
+
+static size_t lz4_compress_block(const BYTE *src, size_t srcn, BYTE *dst,
+				 size_t dstn, uint32_t *table)
+{
+	const BYTE *ip = src;
+	const BYTE *anchor = src;
+	const BYTE *const iend = src + srcn;
+	size_t out = 0;
+	size_t size;
+
+	memset(table, 0, sizeof(*table) << LZ4_HASH_LOG);
+
+	/* The last match must start at least MFLIMIT bytes before the end of
+	   the block and the last LASTLITERALS bytes are always literals. */
+	if (srcn > MFLIMIT) {
+		const BYTE *const mflimit = iend - MFLIMIT;
+		const BYTE *const matchlimit = iend - LASTLITERALS;
+
+		while (ip < mflimit) {
+			uint32_t seq = LZ4_read32(ip);
+			uint32_t *entry = &table[LZ4_hash4(seq)];
+			const BYTE *match = src + *entry;
+			const BYTE *end;
+
+			*entry = ip - src;
+			if (match >= ip || ip - match > MAX_DISTANCE ||
+			    LZ4_read32(match) != seq) {
+				/* Skip ahead faster through incompressible
+				   data, like LZ4 does. */
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			while (ip > anchor && match > src && ip[-1] == match[-1]) {
+				ip--;
+				match--;
+			}
+			end = ip + MINMATCH;
+			while (end < matchlimit && *end == match[end - ip])
+				end++;
+
+			size = lz4_emit_sequence(NULL, anchor, ip - anchor,
+					ip - match, end - ip - MINMATCH);
+			if (out + size > dstn)
+				return 0;
+			if (dst)
+				lz4_emit_sequence(dst + out, anchor, ip - anchor,
+						ip - match, end - ip - MINMATCH);
+			out += size;
+			ip = anchor = end;
+		}
+	}
+
+	size = lz4_emit_sequence(NULL, anchor, iend - anchor, 0, 0);
+	if (out + size > dstn)
+		return 0;
+	if (dst)
+		lz4_emit_sequence(dst + out, anchor, iend - anchor, 0, 0);
+
+	return out + size;
+}
+
+/* xxHash32 with seed 0 for inputs shorter than 16 bytes, as needed for the
+ * frame descriptor checksum. */
+static BYTE lz4_header_checksum(const BYTE *p, size_t len)
+{
+	const uint32_t prime1 = 2654435761U, prime2 = 2246822519U;
+	const uint32_t prime3 = 3266489917U, prime4 = 668265263U;
+	const uint32_t prime5 = 374761393U;
+	uint32_t h = prime5 + len;
+
+	for (; len >= 4; p += 4, len -= 4) {
+		h += le32toh(LZ4_read32(p)) * prime3;
+		h = ((h << 17) | (h >> 15)) * prime4;
+	}
+	for (; len; p++, len--) {
+		h += *p * prime5;
+		h = ((h << 11) | (h >> 21)) * prime1;
+	}
+
+	h ^= h >> 15;
+	h *= prime2;
+	h ^= h >> 13;
+	h *= prime3;
+	h ^= h >> 16;
+
+	return (h >> 8) & 0xff;
+}
+
+size_t clz4fn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	static uint32_t table[1 << LZ4_HASH_LOG];
+	/* Version 1, independent blocks, content size, 4MB max block size. */
+	const BYTE header[] = { 0x04, 0x22, 0x4d, 0x18, 0x68, 0x70 };
+	const size_t header_size = sizeof(header) + sizeof(uint64_t) + 1;
+	size_t out = header_size;
+	size_t in = 0;
+
+	if (!dst)
+		dstn = (size_t)-1;
+	if (dstn < header_size)
+		return 0;
+	if (dst) {
+		uint64_t content_size = htole64(srcn);
+
+		memcpy(dst, header, sizeof(header));
+		memcpy(dst + sizeof(header), &content_size, sizeof(content_size));
+		/* The checksum covers the descriptor, i.e. all but the magic. */
+		((BYTE *)dst)[header_size - 1] = lz4_header_checksum(dst + 4,
+							header_size - 5);
+	}
+
+	do {
+		size_t block = MIN(srcn - in, LZ4F_MAX_BLOCK_SIZE);
+		size_t avail, size;
+		uint32_t block_header;
+
+		if (dstn - out < sizeof(block_header))
+			return 0;
+		avail = dstn - out - sizeof(block_header);
+
+		/* Store the block uncompressed if compressing doesn't help. */
+		size = lz4_compress_block(src + in, block,
+					  dst ? dst + out + sizeof(block_header) : NULL,
+					  MIN(avail, block), table);
+		if (size && size < block) {
+			block_header = size;
+		} else {
+			if (block > avail)
+				return 0;
+			if (dst)
+				memcpy(dst + out + sizeof(block_header),
+				       src + in, block);
+			size = block;
+			block_header = size | (1U << 31);
+		}
+		if (dst) {
+			block_header = htole32(block_header);
+			memcpy(dst + out, &block_header, sizeof(block_header));
+		}
+		out += sizeof(block_header) + size;
+		in += block;
+	} while (in < srcn);
+
+	/* End mark */
+	if (dstn - out < sizeof(uint32_t))
+		return 0;
+	if (dst)
+		memset(dst + out, 0, sizeof(uint32_t));
+
+	return out + sizeof(uint32_t);
+}
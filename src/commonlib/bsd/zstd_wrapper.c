@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: BSD-3-Clause OR GPL-2.0-only */
+
+#include <commonlib/bsd/compression.h>
+#include <stdint.h>
+
+/* Build the upstream zstd decoder as a single translation unit, the same way
+ * zstd's own build/single_file_libs/zstddeclib-in.c does. Compression,
+ * dictionary training and legacy formats are left out. */
+#define DEBUGLEVEL 0
+#define ZSTD_LEGACY_SUPPORT 0
+#define ZSTD_STRIP_ERROR_STRINGS
+#define ZSTD_NO_TRACE
+#define ZSTD_DISABLE_ASM 1
+#define DYNAMIC_BMI2 0
+#define ZSTD_NO_INTRINSICS
+#undef XXH_NAMESPACE
+#define XXH_NAMESPACE ZSTD_
+#define XXH_PRIVATE_API
+#define XXH_INLINE_ALL
+#define XXH_NO_STDLIB
+#define ZSTD_STATIC_LINKING_ONLY
+
+#include "zstd/common/debug.c"		/* #include for inlining, do not link! */
+#include "zstd/common/entropy_common.c"
+#include "zstd/common/error_private.c"
+#include "zstd/common/fse_decompress.c"
+#include "zstd/common/zstd_common.c"
+#include "zstd/decompress/huf_decompress.c"
+#include "zstd/decompress/zstd_ddict.c"
+#include "zstd/decompress/zstd_decompress.c"
+#include "zstd/decompress/zstd_decompress_block.c"
+
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	/* The context holds the entropy tables and a literal buffer of about
+	   100KiB. It lives in .bss so that no heap is needed. */
+	static ZSTD_DCtx dctx_space;
+	ZSTD_DCtx *dctx;
+	size_t ret;
+
+	dctx = ZSTD_initStaticDCtx(&dctx_space, sizeof(dctx_space));
+	if (!dctx)
+		return 0;
+
+	/* The whole output buffer is available up front, so the decoder
+	   doesn't need a separate window buffer. */
+	ret = ZSTD_decompressDCtx(dctx, dst, dstn, src, srcn);
+	if (ZSTD_isError(ret))
+		return 0;
+
+	return ret;
+}
@@ -141,6 +141,31 @@ int cbfsf_decompression_info(struct cbfsf *fh, uint32_t *algo, size_t *size)
 	return 0;
 }
 
+int cbfsf_inplace_info(struct cbfsf *fh, size_t *decompressed_size,
+		       size_t *margin)
+{
+	size_t metadata_size = region_device_sz(&fh->metadata);
+	void *metadata = rdev_mmap_full(&fh->metadata);
+	size_t offs = 0;
+
+	if (!metadata)
+		return -1;
+
+	while ((offs = cbfs_for_each_attr(metadata, metadata_size, offs))) {
+		struct cbfs_file_attr_inplace *attr = metadata + offs;
+		if (read_be32(&attr->tag) != CBFS_FILE_ATTR_TAG_INPLACE)
+			continue;
+
+		*decompressed_size = read_be32(&attr->decompressed_size);
+		*margin = read_be32(&attr->margin);
+		rdev_munmap(&fh->metadata, metadata);
+		return 0;
+	}
+
+	rdev_munmap(&fh->metadata, metadata);
+	return -1;
+}
+
 int cbfsf_file_type(struct cbfsf *fh, uint32_t *ftype)
 {
 	const size_t sz = sizeof(*ftype);
@@ -56,6 +56,16 @@ size_t cbfs_for_each_attr(void *metadata, size_t metadata_size,
  */
 int cbfsf_decompression_info(struct cbfsf *fh, uint32_t *algo, size_t *size);
 
+/*
+ * Find out how large a buffer has to be to decompress a stage in place, by
+ * parsing the attribute cbfstool records for compressed stages. The compressed
+ * data must be loaded to the very end of a buffer that is at least
+ * decompressed_size + margin bytes. Returns 0 on success and < 0 if the file
+ * doesn't carry that information.
+ */
+int cbfsf_inplace_info(struct cbfsf *fh, size_t *decompressed_size,
+		       size_t *margin);
+
 /*
  * Return the CBFS file type as out-parameter.
  * Returns 0 on success and < 0 on error.
@@ -59,6 +59,7 @@
 #define CBMEM_ID_VBOOT_SEL_REG	0x780074f1  /* deprecated */
 #define CBMEM_ID_VBOOT_WORKBUF	0x78007343
 #define CBMEM_ID_VPD		0x56504420
+#define CBMEM_ID_VPD_INDEX	0x56504449
 #define CBMEM_ID_WIFI_CALIBRATION 0x57494649
 #define CBMEM_ID_EC_HOSTEVENT	0x63ccbbc3  /* deprecated */
 #define CBMEM_ID_EXT_VBT	0x69866684
@@ -121,6 +122,7 @@
 	{ CBMEM_ID_VBOOT_SEL_REG,	"VBOOT SEL  " }, \
 	{ CBMEM_ID_VBOOT_WORKBUF,	"VBOOT WORK " }, \
 	{ CBMEM_ID_VPD,			"VPD        " }, \
+	{ CBMEM_ID_VPD_INDEX,		"VPD INDEX  " }, \
 	{ CBMEM_ID_WIFI_CALIBRATION,	"WIFI CLBR  " }, \
 	{ CBMEM_ID_EC_HOSTEVENT,	"EC HOSTEVENT"}, \
 	{ CBMEM_ID_EXT_VBT,		"EXT VBT"}, \
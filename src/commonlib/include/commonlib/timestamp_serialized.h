@@ -36,7 +36,11 @@ enum timestamp_id {
 	TS_END_ULZMA = 16,
 	TS_START_ULZ4F = 17,
 	TS_END_ULZ4F = 18,
+	TS_START_UZSTD = 19,
+	TS_END_UZSTD = 20,
 	TS_DEVICE_ENUMERATE = 30,
+	TS_PCIE_LINK_TRAIN_START = 31,
+	TS_PCIE_LINK_TRAIN_END = 32,
 	TS_DEVICE_CONFIGURE = 40,
 	TS_DEVICE_ENABLE = 50,
 	TS_DEVICE_INITIALIZE = 60,
@@ -163,7 +167,11 @@ static const struct timestamp_id_to_name {
 	{ TS_END_ULZMA,		"finished LZMA decompress (ignore for x86)" },
 	{ TS_START_ULZ4F,	"starting LZ4 decompress (ignore for x86)" },
 	{ TS_END_ULZ4F,		"finished LZ4 decompress (ignore for x86)" },
+	{ TS_START_UZSTD,	"starting Zstandard decompress (ignore for x86)" },
+	{ TS_END_UZSTD,		"finished Zstandard decompress (ignore for x86)" },
 	{ TS_DEVICE_ENUMERATE,	"device enumeration" },
+	{ TS_PCIE_LINK_TRAIN_START, "starting PCIe link retraining" },
+	{ TS_PCIE_LINK_TRAIN_END, "finished PCIe link retraining" },
 	{ TS_DEVICE_CONFIGURE,	"device configuration" },
 	{ TS_DEVICE_ENABLE,	"device enable" },
 	{ TS_DEVICE_INITIALIZE,	"device initialization" },
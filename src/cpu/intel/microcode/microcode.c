@@ -2,14 +2,19 @@
 
 /* Microcode update for Intel PIII and later CPUs */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <cbfs.h>
 #include <arch/cpu.h>
+#include <bootstate.h>
+#include <commonlib/helpers.h>
 #include <console/console.h>
 #include <cpu/x86/msr.h>
+#include <cpu/intel/common/common.h>
 #include <cpu/intel/microcode.h>
 #include <smp/spinlock.h>
+#include <timestamp.h>
 
 DECLARE_SPIN_LOCK(microcode_lock)
 
@@ -117,14 +122,11 @@ uint32_t get_microcode_checksum(const void *microcode)
 	return ((struct microcode *)microcode)->cksum;
 }
 
-const void *intel_microcode_find(void)
+static const void *find_cbfs_microcode(u32 sig, u32 pf)
 {
 	const struct microcode *ucode_updates;
 	size_t microcode_len;
-	u32 eax;
-	u32 pf, rev, sig, update_size;
-	unsigned int x86_model, x86_family;
-	msr_t msr;
+	u32 update_size;
 
 	ucode_updates = cbfs_boot_map_with_leak(MICROCODE_CBFS_FILE,
 						CBFS_TYPE_MICROCODE,
@@ -132,6 +134,50 @@ const void *intel_microcode_find(void)
 	if (ucode_updates == NULL)
 		return NULL;
 
+	while (microcode_len >= sizeof(*ucode_updates)) {
+		/* Newer microcode updates include a size field, whereas older
+		 * containers set it at 0 and are exactly 2048 bytes long */
+		if (ucode_updates->total_size) {
+			update_size = ucode_updates->total_size;
+		} else {
+			printk(BIOS_SPEW, "Microcode size field is 0\n");
+			update_size = 2048;
+		}
+
+		/* Checkpoint 1: The microcode update falls within CBFS */
+		if (update_size > microcode_len) {
+			printk(BIOS_WARNING, "Microcode header corrupted!\n");
+			break;
+		}
+
+		if ((ucode_updates->sig == sig) && (ucode_updates->pf & pf))
+			return ucode_updates;
+
+		ucode_updates = (void *)((char *)ucode_updates + update_size);
+		microcode_len -= update_size;
+	}
+
+	return NULL;
+}
+
+const void *intel_microcode_find(void)
+{
+	/*
+	 * In ramstage every AP looks up its patch again. Remember the last
+	 * lookup so CPUs with the same signature do not walk the blob again.
+	 */
+	static struct {
+		bool valid;
+		u32 sig;
+		u32 pf;
+		const void *patch;
+	} last_find;
+	const void *patch;
+	u32 eax;
+	u32 pf, rev, sig;
+	unsigned int x86_model, x86_family;
+	msr_t msr;
+
 	/* CPUID sets MSR 0x8B if a microcode update has been loaded. */
 	msr.lo = 0;
 	msr.hi = 0;
@@ -152,41 +198,97 @@ const void *intel_microcode_find(void)
 	printk(BIOS_DEBUG, "microcode: sig=0x%x pf=0x%x revision=0x%x\n",
 			sig, pf, rev);
 
-	while (microcode_len >= sizeof(*ucode_updates)) {
-		/* Newer microcode updates include a size field, whereas older
-		 * containers set it at 0 and are exactly 2048 bytes long */
-		if (ucode_updates->total_size) {
-			update_size = ucode_updates->total_size;
-		} else {
-			printk(BIOS_SPEW, "Microcode size field is 0\n");
-			update_size = 2048;
-		}
+	if (ENV_RAMSTAGE && last_find.valid && last_find.sig == sig &&
+	    last_find.pf == pf)
+		return last_find.patch;
 
-		/* Checkpoint 1: The microcode update falls within CBFS */
-		if (update_size > microcode_len) {
-			printk(BIOS_WARNING, "Microcode header corrupted!\n");
-			break;
-		}
+	patch = find_cbfs_microcode(sig, pf);
 
-		if ((ucode_updates->sig == sig) && (ucode_updates->pf & pf))
-			return ucode_updates;
+	if (ENV_RAMSTAGE) {
+		last_find.sig = sig;
+		last_find.pf = pf;
+		last_find.patch = patch;
+		last_find.valid = true;
+	}
 
-		ucode_updates = (void *)((char *)ucode_updates + update_size);
-		microcode_len -= update_size;
+	return patch;
+}
+
+#if ENV_RAMSTAGE
+/* Time each CPU spent loading its microcode, in timestamp ticks. */
+static uint64_t microcode_load_ticks[CONFIG_MAX_CPUS];
+
+static void record_microcode_load(uint64_t start)
+{
+	const int cpu = cpu_index();
+
+	if (cpu >= 0 && cpu < CONFIG_MAX_CPUS)
+		microcode_load_ticks[cpu] = timestamp_get() - start;
+}
+
+/* Summarize on the BSP once all CPUs are initialized, instead of one line per CPU. */
+static void report_microcode_loads(void *unused)
+{
+	uint64_t us, min_us = UINT64_MAX, max_us = 0;
+	int i, num_loads = 0;
+	int mhz;
+
+	if (!CONFIG(COLLECT_TIMESTAMPS))
+		return;
+
+	mhz = timestamp_tick_freq_mhz();
+	if (mhz <= 0)
+		return;
+
+	for (i = 0; i < CONFIG_MAX_CPUS; i++) {
+		/* HT siblings and absent CPUs did not load anything. */
+		if (!microcode_load_ticks[i])
+			continue;
+		us = microcode_load_ticks[i] / mhz;
+		min_us = MIN(min_us, us);
+		max_us = MAX(max_us, us);
+		num_loads++;
 	}
 
-	return NULL;
+	if (num_loads)
+		printk(BIOS_DEBUG, "microcode: %d loads took min %llu us, max %llu us\n",
+		       num_loads, min_us, max_us);
 }
 
+BOOT_STATE_INIT_ENTRY(BS_DEV_INIT, BS_ON_EXIT, report_microcode_loads, NULL);
+#else
+static void record_microcode_load(uint64_t start)
+{
+}
+#endif
+
 void intel_update_microcode_from_cbfs(void)
 {
-	const void *patch = intel_microcode_find();
+	const bool per_core = ENV_RAMSTAGE && CONFIG(MICROCODE_UPDATE_PER_CORE);
+	const void *patch;
+	uint64_t start;
 
+	/* Threads of a core share its microcode, only the first one loads it. */
+	if (per_core && intel_ht_sibling())
+		return;
+
+	start = timestamp_get();
+
+	/* The lookup shares state between CPUs, so it is done under the lock too. */
 	spin_lock(&microcode_lock);
 
-	intel_microcode_load_unlocked(patch);
+	patch = intel_microcode_find();
+
+	if (per_core) {
+		spin_unlock(&microcode_lock);
+		intel_microcode_load_unlocked(patch);
+	} else {
+		intel_microcode_load_unlocked(patch);
+		spin_unlock(&microcode_lock);
+	}
 
-	spin_unlock(&microcode_lock);
+	if (CONFIG(COLLECT_TIMESTAMPS))
+		record_microcode_load(start);
 }
 
 #if ENV_RAMSTAGE
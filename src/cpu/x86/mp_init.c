@@ -25,6 +25,7 @@
 #include <symbols.h>
 #include <timer.h>
 #include <thread.h>
+#include <timestamp.h>
 
 #include <security/intel/stm/SmmStm.h>
 
@@ -860,14 +861,67 @@ static void load_smm_handlers(void)
 		mp_state.ops.pre_mp_smm_init();
 }
 
+/* Time each CPU spent in its SMM relocation, in timestamp ticks. */
+static uint64_t smm_relocation_ticks[CONFIG_MAX_CPUS];
+
 /* Trigger SMM as part of MP flight record. */
 static void trigger_smm_relocation(void)
 {
+	int cpu;
+	uint64_t start;
+
 	/* Do nothing if SMM is disabled.*/
 	if (!is_smm_enabled() || mp_state.ops.per_cpu_smm_trigger == NULL)
 		return;
+
+	cpu = cpu_index();
+	start = timestamp_get();
+
 	/* Trigger SMM mode for the currently running processor. */
 	mp_state.ops.per_cpu_smm_trigger();
+
+	if (cpu >= 0 && cpu < CONFIG_MAX_CPUS)
+		smm_relocation_ticks[cpu] = timestamp_get() - start;
+}
+
+/*
+ * Report the per-CPU relocation times. Only valid once every CPU has left
+ * trigger_smm_relocation(), i.e. on the BSP after the next blocking record.
+ */
+static void report_smm_relocation(void)
+{
+	uint64_t us, min_us = UINT64_MAX, max_us = 0, total_us = 0;
+	int num_cpus = MIN(mp_state.cpu_count, CONFIG_MAX_CPUS);
+	int mhz, i;
+
+	if (!CONFIG(COLLECT_TIMESTAMPS) || !is_smm_enabled() ||
+	    mp_state.ops.per_cpu_smm_trigger == NULL || num_cpus <= 0)
+		return;
+
+	mhz = timestamp_tick_freq_mhz();
+	if (mhz <= 0)
+		return;
+
+	for (i = 0; i < num_cpus; i++) {
+		us = smm_relocation_ticks[i] / mhz;
+		printk(BIOS_SPEW, "CPU %d: SMM relocation took %llu us\n", i, us);
+		min_us = MIN(min_us, us);
+		max_us = MAX(max_us, us);
+		total_us += us;
+	}
+
+	printk(BIOS_DEBUG, "SMM relocation on %d CPUs: min %llu us, max %llu us, sum %llu us\n",
+	       num_cpus, min_us, max_us, total_us);
+}
+
+/*
+ * The BSP runs this once all APs checked in for CPU initialization, so their
+ * SMM relocation is done and can be reported without another flight record.
+ */
+static void bsp_initialize_cpu(void)
+{
+	report_smm_relocation();
+	mp_initialize_cpu();
 }
 
 static struct mp_callback *ap_callbacks[CONFIG_MAX_CPUS];
@@ -1027,7 +1081,7 @@ static struct mp_flight_record mp_steps[] = {
 	/* Perform SMM relocation. */
 	MP_FR_NOBLOCK_APS(trigger_smm_relocation, trigger_smm_relocation),
 	/* Initialize each CPU through the driver framework. */
-	MP_FR_BLOCK_APS(mp_initialize_cpu, mp_initialize_cpu),
+	MP_FR_BLOCK_APS(mp_initialize_cpu, bsp_initialize_cpu),
 	/* Wait for APs to finish then optionally start looking for work. */
 	MP_FR_BLOCK_APS(ap_wait_for_instruction, NULL),
 };
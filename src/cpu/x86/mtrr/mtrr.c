@@ -22,6 +22,9 @@
 #include <memrange.h>
 #include <cpu/amd/mtrr.h>
 #include <assert.h>
+
+#include "var_mtrr.h"
+
 #if CONFIG(X86_AMD_FIXED_MTRRS)
 #define MTRR_FIXED_WRBACK_BITS (MTRR_READ_MEM | MTRR_WRITE_MEM)
 #else
@@ -32,15 +35,9 @@
 #define BIOS_MTRRS 6
 #define OS_MTRRS   2
 #define MTRRS      (BIOS_MTRRS + OS_MTRRS)
-/*
- * Static storage size for variable MTRRs. It's sized sufficiently large to
- * handle different types of CPUs. Empirically, 16 variable MTRRs has not
- * yet been observed.
- */
-#define NUM_MTRR_STATIC_STORAGE 16
 
-static int total_mtrrs = MTRRS;
-static int bios_mtrrs = BIOS_MTRRS;
+int total_mtrrs = MTRRS;
+int bios_mtrrs = BIOS_MTRRS;
 
 static void detect_var_mtrrs(void)
 {
@@ -104,47 +101,22 @@ static void enable_var_mtrr(unsigned char deftype)
 
 #define MTRR_VERBOSE_LEVEL BIOS_NEVER
 
-/* MTRRs are at a 4KiB granularity. Therefore all address calculations can
- * be done with 32-bit numbers. This allows for the MTRR code to handle
- * up to 2^44 bytes (16 TiB) of address space. */
-#define RANGE_SHIFT 12
-#define ADDR_SHIFT_TO_RANGE_SHIFT(x) \
-	(((x) > RANGE_SHIFT) ? ((x) - RANGE_SHIFT) : RANGE_SHIFT)
-#define PHYS_TO_RANGE_ADDR(x) ((x) >> RANGE_SHIFT)
-#define RANGE_TO_PHYS_ADDR(x) (((resource_t)(x)) << RANGE_SHIFT)
 #define NUM_FIXED_MTRRS (NUM_FIXED_RANGES / RANGES_PER_FIXED_MTRR)
 
-/* Helpful constants. */
-#define RANGE_1MB PHYS_TO_RANGE_ADDR(1 << 20)
-#define RANGE_4GB (1 << (ADDR_SHIFT_TO_RANGE_SHIFT(32)))
-
-#define MTRR_ALGO_SHIFT (8)
-#define MTRR_TAG_MASK ((1 << MTRR_ALGO_SHIFT) - 1)
-
-static inline uint32_t range_entry_base_mtrr_addr(struct range_entry *r)
-{
-	return PHYS_TO_RANGE_ADDR(range_entry_base(r));
-}
-
-static inline uint32_t range_entry_end_mtrr_addr(struct range_entry *r)
-{
-	return PHYS_TO_RANGE_ADDR(range_entry_end(r));
-}
-
-static inline int range_entry_mtrr_type(struct range_entry *r)
-{
-	return range_entry_tag(r) & MTRR_TAG_MASK;
-}
-
 static int filter_vga_wrcomb(struct device *dev, struct resource *res)
 {
 	/* Only handle PCI devices. */
 	if (dev->path.type != DEVICE_PATH_PCI)
 		return 0;
 
-	/* Only handle VGA class devices. */
-	if (((dev->class >> 8) != PCI_CLASS_DISPLAY_VGA))
+	/* Only handle VGA class devices, unless all display controllers
+	 * were asked for. */
+	if (CONFIG(MTRR_WRCOMB_ALL_DISPLAY)) {
+		if ((dev->class >> 16) != PCI_BASE_CLASS_DISPLAY)
+			return 0;
+	} else if ((dev->class >> 8) != PCI_CLASS_DISPLAY_VGA) {
 		return 0;
+	}
 
 	/* Add resource as write-combining in the address space. */
 	return 1;
@@ -369,30 +341,9 @@ void x86_setup_fixed_mtrrs(void)
 	enable_fixed_mtrr();
 }
 
-struct var_mtrr_regs {
-	msr_t base;
-	msr_t mask;
-};
-
-struct var_mtrr_solution {
-	int mtrr_default_type;
-	int num_used;
-	struct var_mtrr_regs regs[NUM_MTRR_STATIC_STORAGE];
-};
-
 /* Global storage for variable MTRR solution. */
 static struct var_mtrr_solution mtrr_global_solution;
 
-struct var_mtrr_state {
-	struct memranges *addr_space;
-	int above4gb;
-	int address_bits;
-	int prepare_msrs;
-	int mtrr_index;
-	int def_mtrr_type;
-	struct var_mtrr_regs *regs;
-};
-
 static void clear_var_mtrr(int index)
 {
 	msr_t msr = { .lo = 0, .hi = 0 };
@@ -401,335 +352,6 @@ static void clear_var_mtrr(int index)
 	wrmsr(MTRR_PHYS_MASK(index), msr);
 }
 
-static void prep_var_mtrr(struct var_mtrr_state *var_state,
-			  uint32_t base, uint32_t size, int mtrr_type)
-{
-	struct var_mtrr_regs *regs;
-	resource_t rbase;
-	resource_t rsize;
-	resource_t mask;
-
-	/* Some variable MTRRs are attempted to be saved for the OS use.
-	 * However, it's more important to try to map the full address space
-	 * properly. */
-	if (var_state->mtrr_index >= bios_mtrrs)
-		printk(BIOS_WARNING, "Taking a reserved OS MTRR.\n");
-	if (var_state->mtrr_index >= total_mtrrs) {
-		printk(BIOS_ERR, "ERROR: Not enough MTRRs available! MTRR index is %d with %d MTRRs in total.\n",
-		       var_state->mtrr_index, total_mtrrs);
-		return;
-	}
-
-	rbase = base;
-	rsize = size;
-
-	rbase = RANGE_TO_PHYS_ADDR(rbase);
-	rsize = RANGE_TO_PHYS_ADDR(rsize);
-	rsize = -rsize;
-
-	mask = (1ULL << var_state->address_bits) - 1;
-	rsize = rsize & mask;
-
-	printk(BIOS_DEBUG, "MTRR: %d base 0x%016llx mask 0x%016llx type %d\n",
-	       var_state->mtrr_index, rbase, rsize, mtrr_type);
-
-	regs = &var_state->regs[var_state->mtrr_index];
-
-	regs->base.lo = rbase;
-	regs->base.lo |= mtrr_type;
-	regs->base.hi = rbase >> 32;
-
-	regs->mask.lo = rsize;
-	regs->mask.lo |= MTRR_PHYS_MASK_VALID;
-	regs->mask.hi = rsize >> 32;
-}
-
-static void calc_var_mtrr_range(struct var_mtrr_state *var_state,
-				uint32_t base, uint32_t size, int mtrr_type)
-{
-	while (size != 0) {
-		uint32_t addr_lsb;
-		uint32_t size_msb;
-		uint32_t mtrr_size;
-
-		addr_lsb = fls(base);
-		size_msb = fms(size);
-
-		/* All MTRR entries need to have their base aligned to the mask
-		 * size. The maximum size is calculated by a function of the
-		 * min base bit set and maximum size bit set. */
-		if (addr_lsb > size_msb)
-			mtrr_size = 1 << size_msb;
-		else
-			mtrr_size = 1 << addr_lsb;
-
-		if (var_state->prepare_msrs)
-			prep_var_mtrr(var_state, base, mtrr_size, mtrr_type);
-
-		size -= mtrr_size;
-		base += mtrr_size;
-		var_state->mtrr_index++;
-	}
-}
-
-static uint32_t optimize_var_mtrr_hole(const uint32_t base,
-				       const uint32_t hole,
-				       const uint64_t limit,
-				       const int carve_hole)
-{
-	/*
-	 * With default type UC, we can potentially optimize a WB
-	 * range with unaligned upper end, by aligning it up and
-	 * carving the added "hole" out again.
-	 *
-	 * To optimize the upper end of the hole, we will test
-	 * how many MTRRs calc_var_mtrr_range() will spend for any
-	 * alignment of the hole's upper end.
-	 *
-	 * We take four parameters, the lower end of the WB range
-	 * `base`, upper end of the WB range as start of the `hole`,
-	 * a `limit` how far we may align the upper end of the hole
-	 * up and a flag `carve_hole` whether we should count MTRRs
-	 * for carving the hole out. We return the optimal upper end
-	 * for the hole (which may be the same as the end of the WB
-	 * range in case we don't gain anything by aligning up).
-	 */
-
-	const int dont_care = 0;
-	struct var_mtrr_state var_state = { 0, };
-
-	unsigned int align, best_count;
-	uint32_t best_end = hole;
-
-	/* calculate MTRR count for the WB range alone (w/o a hole) */
-	calc_var_mtrr_range(&var_state, base, hole - base, dont_care);
-	best_count = var_state.mtrr_index;
-	var_state.mtrr_index = 0;
-
-	for (align = fls(hole) + 1; align <= fms(hole); ++align) {
-		const uint64_t hole_end = ALIGN_UP((uint64_t)hole, 1 << align);
-		if (hole_end > limit)
-			break;
-
-		/* calculate MTRR count for this alignment */
-		calc_var_mtrr_range(
-			&var_state, base, hole_end - base, dont_care);
-		if (carve_hole)
-			calc_var_mtrr_range(
-				&var_state, hole, hole_end - hole, dont_care);
-
-		if (var_state.mtrr_index < best_count) {
-			best_count = var_state.mtrr_index;
-			best_end = hole_end;
-		}
-		var_state.mtrr_index = 0;
-	}
-
-	return best_end;
-}
-
-static void calc_var_mtrrs_with_hole(struct var_mtrr_state *var_state,
-				     struct range_entry *r)
-{
-	uint32_t a1, a2, b1, b2;
-	int mtrr_type, carve_hole;
-
-	/*
-	 * Determine MTRRs based on the following algorithm for the given entry:
-	 * +------------------+ b2 = ALIGN_UP(end)
-	 * |  0 or more bytes | <-- hole is carved out between b1 and b2
-	 * +------------------+ a2 = b1 = original end
-	 * |                  |
-	 * +------------------+ a1 = begin
-	 *
-	 * Thus, there are up to 2 sub-ranges to configure variable MTRRs for.
-	 */
-	mtrr_type = range_entry_mtrr_type(r);
-
-	a1 = range_entry_base_mtrr_addr(r);
-	a2 = range_entry_end_mtrr_addr(r);
-
-	/* The end address is within the first 1MiB. The fixed MTRRs take
-	 * precedence over the variable ones. Therefore this range
-	 * can be ignored. */
-	if (a2 <= RANGE_1MB)
-		return;
-
-	/* Again, the fixed MTRRs take precedence so the beginning
-	 * of the range can be set to 0 if it starts at or below 1MiB. */
-	if (a1 <= RANGE_1MB)
-		a1 = 0;
-
-	/* If the range starts above 4GiB the processing is done. */
-	if (!var_state->above4gb && a1 >= RANGE_4GB)
-		return;
-
-	/* Clip the upper address to 4GiB if addresses above 4GiB
-	 * are not being processed. */
-	if (!var_state->above4gb && a2 > RANGE_4GB)
-		a2 = RANGE_4GB;
-
-	b1 = a2;
-	b2 = a2;
-	carve_hole = 0;
-
-	/* We only consider WB type ranges for hole-carving. */
-	if (mtrr_type == MTRR_TYPE_WRBACK) {
-		struct range_entry *next;
-		uint64_t b2_limit;
-		/*
-		 * Depending on the type of the next range, there are three
-		 * different situations to handle:
-		 *
-		 * 1. WB range is last in address space:
-		 *    Aligning up, up to the next power of 2, may gain us
-		 *    something.
-		 *
-		 * 2. The next range is of type UC:
-		 *    We may align up, up to the _end_ of the next range. If
-		 *    there is a gap between the current and the next range,
-		 *    it would have been covered by the default type UC anyway.
-		 *
-		 * 3. The next range is not of type UC:
-		 *    We may align up, up to the _base_ of the next range. This
-		 *    may either be the end of the current range (if the next
-		 *    range follows immediately) or the end of the gap between
-		 *    the ranges.
-		 */
-		next = memranges_next_entry(var_state->addr_space, r);
-		if (next == NULL) {
-			b2_limit = ALIGN_UP((uint64_t)b1, 1 << fms(b1));
-			/* If it's the last range above 4GiB, we won't carve
-			   the hole out. If an OS wanted to move MMIO there,
-			   it would have to override the MTRR setting using
-			   PAT just like it would with WB as default type. */
-			carve_hole = a1 < RANGE_4GB;
-		} else if (range_entry_mtrr_type(next)
-				== MTRR_TYPE_UNCACHEABLE) {
-			b2_limit = range_entry_end_mtrr_addr(next);
-			carve_hole = 1;
-		} else {
-			b2_limit = range_entry_base_mtrr_addr(next);
-			carve_hole = 1;
-		}
-		b2 = optimize_var_mtrr_hole(a1, b1, b2_limit, carve_hole);
-	}
-
-	calc_var_mtrr_range(var_state, a1, b2 - a1, mtrr_type);
-	if (carve_hole && b2 != b1) {
-		calc_var_mtrr_range(var_state, b1, b2 - b1,
-				    MTRR_TYPE_UNCACHEABLE);
-	}
-}
-
-static void __calc_var_mtrrs(struct memranges *addr_space,
-			     int above4gb, int address_bits,
-			     int *num_def_wb_mtrrs, int *num_def_uc_mtrrs)
-{
-	int wb_deftype_count;
-	int uc_deftype_count;
-	struct range_entry *r;
-	struct var_mtrr_state var_state;
-
-	/* The default MTRR cacheability type is determined by calculating
-	 * the number of MTRRs required for each MTRR type as if it was the
-	 * default. */
-	var_state.addr_space = addr_space;
-	var_state.above4gb = above4gb;
-	var_state.address_bits = address_bits;
-	var_state.prepare_msrs = 0;
-
-	wb_deftype_count = 0;
-	uc_deftype_count = 0;
-
-	/*
-	 * For each range do 2 calculations:
-	 *   1. UC as default type with possible holes at top of range.
-	 *   2. WB as default.
-	 * The lowest count is then used as default after totaling all
-	 * MTRRs. UC takes precedence in the MTRR architecture. There-
-	 * fore, only holes can be used when the type of the region is
-	 * MTRR_TYPE_WRBACK with MTRR_TYPE_UNCACHEABLE as the default
-	 * type.
-	 */
-	memranges_each_entry(r, var_state.addr_space) {
-		int mtrr_type;
-
-		mtrr_type = range_entry_mtrr_type(r);
-
-		if (mtrr_type != MTRR_TYPE_UNCACHEABLE) {
-			var_state.mtrr_index = 0;
-			var_state.def_mtrr_type = MTRR_TYPE_UNCACHEABLE;
-			calc_var_mtrrs_with_hole(&var_state, r);
-			uc_deftype_count += var_state.mtrr_index;
-		}
-
-		if (mtrr_type != MTRR_TYPE_WRBACK) {
-			var_state.mtrr_index = 0;
-			var_state.def_mtrr_type = MTRR_TYPE_WRBACK;
-			calc_var_mtrrs_with_hole(&var_state, r);
-			wb_deftype_count += var_state.mtrr_index;
-		}
-	}
-	*num_def_wb_mtrrs = wb_deftype_count;
-	*num_def_uc_mtrrs = uc_deftype_count;
-}
-
-static int calc_var_mtrrs(struct memranges *addr_space,
-			  int above4gb, int address_bits)
-{
-	int wb_deftype_count = 0;
-	int uc_deftype_count = 0;
-
-	__calc_var_mtrrs(addr_space, above4gb, address_bits, &wb_deftype_count,
-			 &uc_deftype_count);
-
-	if (wb_deftype_count > bios_mtrrs && uc_deftype_count > bios_mtrrs) {
-		printk(BIOS_DEBUG, "MTRR: Removing WRCOMB type. "
-		       "WB/UC MTRR counts: %d/%d > %d.\n",
-		       wb_deftype_count, uc_deftype_count, bios_mtrrs);
-		memranges_update_tag(addr_space, MTRR_TYPE_WRCOMB,
-				     MTRR_TYPE_UNCACHEABLE);
-		__calc_var_mtrrs(addr_space, above4gb, address_bits,
-				 &wb_deftype_count, &uc_deftype_count);
-	}
-
-	printk(BIOS_DEBUG, "MTRR: default type WB/UC MTRR counts: %d/%d.\n",
-	       wb_deftype_count, uc_deftype_count);
-
-	if (wb_deftype_count < uc_deftype_count) {
-		printk(BIOS_DEBUG, "MTRR: WB selected as default type.\n");
-		return MTRR_TYPE_WRBACK;
-	}
-	printk(BIOS_DEBUG, "MTRR: UC selected as default type.\n");
-	return MTRR_TYPE_UNCACHEABLE;
-}
-
-static void prepare_var_mtrrs(struct memranges *addr_space, int def_type,
-				int above4gb, int address_bits,
-				struct var_mtrr_solution *sol)
-{
-	struct range_entry *r;
-	struct var_mtrr_state var_state;
-
-	var_state.addr_space = addr_space;
-	var_state.above4gb = above4gb;
-	var_state.address_bits = address_bits;
-	/* Prepare the MSRs. */
-	var_state.prepare_msrs = 1;
-	var_state.mtrr_index = 0;
-	var_state.def_mtrr_type = def_type;
-	var_state.regs = &sol->regs[0];
-
-	memranges_each_entry(r, var_state.addr_space) {
-		if (range_entry_mtrr_type(r) == def_type)
-			continue;
-		calc_var_mtrrs_with_hole(&var_state, r);
-	}
-
-	/* Update the solution. */
-	sol->num_used = var_state.mtrr_index;
-}
 
 static int commit_var_mtrrs(const struct var_mtrr_solution *sol)
 {
@@ -0,0 +1,428 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/*
+ * Variable MTRR solver: turns the physical address space into a set of
+ * variable MTRR register values without touching any MSRs.
+ */
+
+#include <commonlib/helpers.h>
+#include <console/console.h>
+#include <cpu/x86/msr.h>
+#include <cpu/x86/mtrr.h>
+#include <memrange.h>
+
+#include "var_mtrr.h"
+
+struct var_mtrr_state {
+	struct memranges *addr_space;
+	int above4gb;
+	int address_bits;
+	int prepare_msrs;
+	int mtrr_index;
+	int def_mtrr_type;
+	struct var_mtrr_regs *regs;
+};
+
+static void prep_var_mtrr(struct var_mtrr_state *var_state,
+			  uint32_t base, uint32_t size, int mtrr_type)
+{
+	struct var_mtrr_regs *regs;
+	resource_t rbase;
+	resource_t rsize;
+	resource_t mask;
+
+	/* Some variable MTRRs are attempted to be saved for the OS use.
+	 * However, it's more important to try to map the full address space
+	 * properly. */
+	if (var_state->mtrr_index >= bios_mtrrs)
+		printk(BIOS_WARNING, "Taking a reserved OS MTRR.\n");
+	if (var_state->mtrr_index >= total_mtrrs) {
+		printk(BIOS_ERR, "ERROR: Not enough MTRRs available! MTRR index is %d with %d MTRRs in total.\n",
+		       var_state->mtrr_index, total_mtrrs);
+		return;
+	}
+
+	rbase = base;
+	rsize = size;
+
+	rbase = RANGE_TO_PHYS_ADDR(rbase);
+	rsize = RANGE_TO_PHYS_ADDR(rsize);
+	rsize = -rsize;
+
+	mask = (1ULL << var_state->address_bits) - 1;
+	rsize = rsize & mask;
+
+	printk(BIOS_DEBUG, "MTRR: %d base 0x%016llx mask 0x%016llx type %d\n",
+	       var_state->mtrr_index, rbase, rsize, mtrr_type);
+
+	regs = &var_state->regs[var_state->mtrr_index];
+
+	regs->base.lo = rbase;
+	regs->base.lo |= mtrr_type;
+	regs->base.hi = rbase >> 32;
+
+	regs->mask.lo = rsize;
+	regs->mask.lo |= MTRR_PHYS_MASK_VALID;
+	regs->mask.hi = rsize >> 32;
+}
+
+static void calc_var_mtrr_range(struct var_mtrr_state *var_state,
+				uint32_t base, uint32_t size, int mtrr_type)
+{
+	while (size != 0) {
+		uint32_t addr_lsb;
+		uint32_t size_msb;
+		uint32_t mtrr_size;
+
+		addr_lsb = fls(base);
+		size_msb = fms(size);
+
+		/* All MTRR entries need to have their base aligned to the mask
+		 * size. The maximum size is calculated by a function of the
+		 * min base bit set and maximum size bit set. */
+		if (addr_lsb > size_msb)
+			mtrr_size = 1 << size_msb;
+		else
+			mtrr_size = 1 << addr_lsb;
+
+		if (var_state->prepare_msrs)
+			prep_var_mtrr(var_state, base, mtrr_size, mtrr_type);
+
+		size -= mtrr_size;
+		base += mtrr_size;
+		var_state->mtrr_index++;
+	}
+}
+
+static unsigned int count_var_mtrrs(uint32_t base, uint32_t end)
+{
+	const int dont_care = 0;
+	struct var_mtrr_state var_state = { 0, };
+
+	if (end > base)
+		calc_var_mtrr_range(&var_state, base, end - base, dont_care);
+
+	return var_state.mtrr_index;
+}
+
+static void optimize_var_mtrr_holes(uint32_t *base, uint32_t *hole,
+				    const uint32_t base_limit,
+				    const uint64_t limit,
+				    const int carve_hole)
+{
+	/*
+	 * With default type UC, we can potentially optimize a WB
+	 * range with unaligned ends, by aligning them and carving
+	 * the added "holes" out again.
+	 *
+	 * The lower end `base` may be aligned down to `base_limit`
+	 * and the upper end, the start of the `hole`, may be aligned
+	 * up to `limit`. The hole below is always carved out, while
+	 * `carve_hole` tells whether the one above is. Every
+	 * combination of alignments is tried and the one spending
+	 * the fewest MTRRs is returned in `base` and `hole` (which
+	 * stay the same if nothing is gained by aligning).
+	 */
+
+	const uint32_t wb_base = *base;
+	const uint32_t wb_end = *hole;
+	unsigned int lo_align, hi_align, count, best_count;
+	uint32_t best_base = wb_base;
+	uint64_t best_end = wb_end;
+
+	/* calculate MTRR count for the WB range alone (w/o holes) */
+	best_count = count_var_mtrrs(wb_base, wb_end);
+
+	for (lo_align = fls(wb_base); lo_align <= 32; ++lo_align) {
+		const uint32_t lo = lo_align < 32 ?
+			ALIGN_DOWN(wb_base, 1UL << lo_align) : 0;
+		unsigned int lo_count;
+
+		if (lo < base_limit)
+			break;
+
+		lo_count = lo != wb_base ? count_var_mtrrs(lo, wb_base) : 0;
+
+		for (hi_align = fls(wb_end); hi_align <= fms(wb_end); ++hi_align) {
+			const uint64_t hi = ALIGN_UP((uint64_t)wb_end, 1ULL << hi_align);
+
+			if (hi > limit || hi > UINT32_MAX)
+				break;
+
+			count = lo_count + count_var_mtrrs(lo, hi);
+			if (carve_hole)
+				count += count_var_mtrrs(wb_end, hi);
+
+			if (count < best_count) {
+				best_count = count;
+				best_base = lo;
+				best_end = hi;
+			}
+		}
+
+		if (lo == 0)
+			break;
+	}
+
+	*base = best_base;
+	*hole = best_end;
+}
+
+static void calc_var_mtrrs_with_hole(struct var_mtrr_state *var_state,
+				     struct range_entry *prev,
+				     struct range_entry *r)
+{
+	uint32_t a1, a2, b1, b2, c1;
+	int mtrr_type, carve_hole;
+
+	/*
+	 * Determine MTRRs based on the following algorithm for the given entry:
+	 * +------------------+ b2 = ALIGN_UP(end)
+	 * |  0 or more bytes | <-- hole is carved out between b1 and b2
+	 * +------------------+ a2 = b1 = original end
+	 * |                  |
+	 * +------------------+ a1 = c2 = original begin
+	 * |  0 or more bytes | <-- hole is carved out between c1 and a1
+	 * +------------------+ c1 = ALIGN_DOWN(begin)
+	 *
+	 * Thus, there are up to 3 sub-ranges to configure variable MTRRs for.
+	 */
+	mtrr_type = range_entry_mtrr_type(r);
+
+	a1 = range_entry_base_mtrr_addr(r);
+	a2 = range_entry_end_mtrr_addr(r);
+
+	/* The end address is within the first 1MiB. The fixed MTRRs take
+	 * precedence over the variable ones. Therefore this range
+	 * can be ignored. */
+	if (a2 <= RANGE_1MB)
+		return;
+
+	/* Again, the fixed MTRRs take precedence so the beginning
+	 * of the range can be set to 0 if it starts at or below 1MiB. */
+	if (a1 <= RANGE_1MB)
+		a1 = 0;
+
+	/* If the range starts above 4GiB the processing is done. */
+	if (!var_state->above4gb && a1 >= RANGE_4GB)
+		return;
+
+	/* Clip the upper address to 4GiB if addresses above 4GiB
+	 * are not being processed. */
+	if (!var_state->above4gb && a2 > RANGE_4GB)
+		a2 = RANGE_4GB;
+
+	b1 = a2;
+	b2 = a2;
+	c1 = a1;
+	carve_hole = 0;
+
+	/* We only consider WB type ranges for hole-carving. */
+	if (mtrr_type == MTRR_TYPE_WRBACK) {
+		struct range_entry *next;
+		uint64_t b2_limit;
+		uint32_t c1_limit;
+		/*
+		 * Depending on the type of the next range, there are three
+		 * different situations to handle:
+		 *
+		 * 1. WB range is last in address space:
+		 *    Aligning up, up to the next power of 2, may gain us
+		 *    something.
+		 *
+		 * 2. The next range is of type UC:
+		 *    We may align up, up to the _end_ of the next range. If
+		 *    there is a gap between the current and the next range,
+		 *    it would have been covered by the default type UC anyway.
+		 *
+		 * 3. The next range is not of type UC:
+		 *    We may align up, up to the _base_ of the next range. This
+		 *    may either be the end of the current range (if the next
+		 *    range follows immediately) or the end of the gap between
+		 *    the ranges.
+		 */
+		next = memranges_next_entry(var_state->addr_space, r);
+		if (next == NULL) {
+			b2_limit = ALIGN_UP((uint64_t)b1, 1 << fms(b1));
+			/* If it's the last range above 4GiB, we won't carve
+			   the hole out. If an OS wanted to move MMIO there,
+			   it would have to override the MTRR setting using
+			   PAT just like it would with WB as default type. */
+			carve_hole = a1 < RANGE_4GB;
+		} else if (range_entry_mtrr_type(next)
+				== MTRR_TYPE_UNCACHEABLE) {
+			b2_limit = range_entry_end_mtrr_addr(next);
+			carve_hole = 1;
+		} else {
+			b2_limit = range_entry_base_mtrr_addr(next);
+			carve_hole = 1;
+		}
+
+		/*
+		 * The same applies to the lower end: we may align down
+		 * into the previous range if it is of type UC, or into
+		 * the gap below the current range otherwise.
+		 */
+		if (prev == NULL)
+			c1_limit = 0;
+		else if (range_entry_mtrr_type(prev) == MTRR_TYPE_UNCACHEABLE)
+			c1_limit = range_entry_base_mtrr_addr(prev);
+		else
+			c1_limit = range_entry_end_mtrr_addr(prev);
+
+		optimize_var_mtrr_holes(&c1, &b2, c1_limit, b2_limit, carve_hole);
+	}
+
+	calc_var_mtrr_range(var_state, c1, b2 - c1, mtrr_type);
+	if (c1 != a1) {
+		calc_var_mtrr_range(var_state, c1, a1 - c1,
+				    MTRR_TYPE_UNCACHEABLE);
+	}
+	if (carve_hole && b2 != b1) {
+		calc_var_mtrr_range(var_state, b1, b2 - b1,
+				    MTRR_TYPE_UNCACHEABLE);
+	}
+}
+
+static void __calc_var_mtrrs(struct memranges *addr_space,
+			     int above4gb, int address_bits,
+			     int *num_def_wb_mtrrs, int *num_def_uc_mtrrs)
+{
+	int wb_deftype_count;
+	int uc_deftype_count;
+	struct range_entry *r, *prev = NULL;
+	struct var_mtrr_state var_state;
+
+	/* The default MTRR cacheability type is determined by calculating
+	 * the number of MTRRs required for each MTRR type as if it was the
+	 * default. */
+	var_state.addr_space = addr_space;
+	var_state.above4gb = above4gb;
+	var_state.address_bits = address_bits;
+	var_state.prepare_msrs = 0;
+
+	wb_deftype_count = 0;
+	uc_deftype_count = 0;
+
+	/*
+	 * For each range do 2 calculations:
+	 *   1. UC as default type with possible holes at top of range.
+	 *   2. WB as default.
+	 * The lowest count is then used as default after totaling all
+	 * MTRRs. UC takes precedence in the MTRR architecture. There-
+	 * fore, only holes can be used when the type of the region is
+	 * MTRR_TYPE_WRBACK with MTRR_TYPE_UNCACHEABLE as the default
+	 * type.
+	 */
+	memranges_each_entry(r, var_state.addr_space) {
+		int mtrr_type;
+
+		mtrr_type = range_entry_mtrr_type(r);
+
+		if (mtrr_type != MTRR_TYPE_UNCACHEABLE) {
+			var_state.mtrr_index = 0;
+			var_state.def_mtrr_type = MTRR_TYPE_UNCACHEABLE;
+			calc_var_mtrrs_with_hole(&var_state, prev, r);
+			uc_deftype_count += var_state.mtrr_index;
+		}
+
+		if (mtrr_type != MTRR_TYPE_WRBACK) {
+			var_state.mtrr_index = 0;
+			var_state.def_mtrr_type = MTRR_TYPE_WRBACK;
+			calc_var_mtrrs_with_hole(&var_state, prev, r);
+			wb_deftype_count += var_state.mtrr_index;
+		}
+
+		prev = r;
+	}
+	*num_def_wb_mtrrs = wb_deftype_count;
+	*num_def_uc_mtrrs = uc_deftype_count;
+}
+
+/* Show which ranges use up the variable MTRRs if there are too few. */
+static void print_var_mtrr_usage(struct memranges *addr_space, int def_type,
+				 int above4gb)
+{
+	struct range_entry *r, *prev = NULL;
+	struct var_mtrr_state var_state = {
+		.addr_space = addr_space,
+		.above4gb = above4gb,
+		.def_mtrr_type = def_type,
+	};
+
+	memranges_each_entry(r, addr_space) {
+		if (range_entry_mtrr_type(r) != def_type) {
+			var_state.mtrr_index = 0;
+			calc_var_mtrrs_with_hole(&var_state, prev, r);
+			printk(BIOS_WARNING, "MTRR: 0x%016llx-0x%016llx type %d needs %d MTRRs\n",
+			       range_entry_base(r), range_entry_end(r) - 1,
+			       range_entry_mtrr_type(r), var_state.mtrr_index);
+		}
+		prev = r;
+	}
+}
+
+int calc_var_mtrrs(struct memranges *addr_space, int above4gb, int address_bits)
+{
+	int wb_deftype_count = 0;
+	int uc_deftype_count = 0;
+	int def_type;
+
+	__calc_var_mtrrs(addr_space, above4gb, address_bits, &wb_deftype_count,
+			 &uc_deftype_count);
+
+	if (wb_deftype_count > bios_mtrrs && uc_deftype_count > bios_mtrrs) {
+		printk(BIOS_DEBUG, "MTRR: Removing WRCOMB type. "
+		       "WB/UC MTRR counts: %d/%d > %d.\n",
+		       wb_deftype_count, uc_deftype_count, bios_mtrrs);
+		memranges_update_tag(addr_space, MTRR_TYPE_WRCOMB,
+				     MTRR_TYPE_UNCACHEABLE);
+		__calc_var_mtrrs(addr_space, above4gb, address_bits,
+				 &wb_deftype_count, &uc_deftype_count);
+	}
+
+	printk(BIOS_DEBUG, "MTRR: default type WB/UC MTRR counts: %d/%d.\n",
+	       wb_deftype_count, uc_deftype_count);
+
+	if (wb_deftype_count < uc_deftype_count) {
+		printk(BIOS_DEBUG, "MTRR: WB selected as default type.\n");
+		def_type = MTRR_TYPE_WRBACK;
+	} else {
+		printk(BIOS_DEBUG, "MTRR: UC selected as default type.\n");
+		def_type = MTRR_TYPE_UNCACHEABLE;
+	}
+
+	if (MIN(wb_deftype_count, uc_deftype_count) > total_mtrrs) {
+		printk(BIOS_WARNING, "MTRR: No solution fits into %d MTRRs.\n",
+		       total_mtrrs);
+		print_var_mtrr_usage(addr_space, def_type, above4gb);
+	}
+
+	return def_type;
+}
+
+void prepare_var_mtrrs(struct memranges *addr_space, int def_type,
+		       int above4gb, int address_bits,
+		       struct var_mtrr_solution *sol)
+{
+	struct range_entry *r, *prev = NULL;
+	struct var_mtrr_state var_state;
+
+	var_state.addr_space = addr_space;
+	var_state.above4gb = above4gb;
+	var_state.address_bits = address_bits;
+	/* Prepare the MSRs. */
+	var_state.prepare_msrs = 1;
+	var_state.mtrr_index = 0;
+	var_state.def_mtrr_type = def_type;
+	var_state.regs = &sol->regs[0];
+
+	memranges_each_entry(r, var_state.addr_space) {
+		if (range_entry_mtrr_type(r) != def_type)
+			calc_var_mtrrs_with_hole(&var_state, prev, r);
+		prev = r;
+	}
+
+	/* Update the solution. */
+	sol->num_used = var_state.mtrr_index;
+}
@@ -0,0 +1,71 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#ifndef CPU_X86_MTRR_VAR_MTRR_H
+#define CPU_X86_MTRR_VAR_MTRR_H
+
+#include <cpu/x86/msr.h>
+#include <memrange.h>
+#include <stdint.h>
+
+/*
+ * Static storage size for variable MTRRs. It's sized sufficiently large to
+ * handle different types of CPUs. Empirically, 16 variable MTRRs has not
+ * yet been observed.
+ */
+#define NUM_MTRR_STATIC_STORAGE 16
+
+/* MTRRs are at a 4KiB granularity. Therefore all address calculations can
+ * be done with 32-bit numbers. This allows for the MTRR code to handle
+ * up to 2^44 bytes (16 TiB) of address space. */
+#define RANGE_SHIFT 12
+#define ADDR_SHIFT_TO_RANGE_SHIFT(x) \
+	(((x) > RANGE_SHIFT) ? ((x) - RANGE_SHIFT) : RANGE_SHIFT)
+#define PHYS_TO_RANGE_ADDR(x) ((x) >> RANGE_SHIFT)
+#define RANGE_TO_PHYS_ADDR(x) (((resource_t)(x)) << RANGE_SHIFT)
+
+/* Helpful constants. */
+#define RANGE_1MB PHYS_TO_RANGE_ADDR(1 << 20)
+#define RANGE_4GB (1 << (ADDR_SHIFT_TO_RANGE_SHIFT(32)))
+
+#define MTRR_ALGO_SHIFT (8)
+#define MTRR_TAG_MASK ((1 << MTRR_ALGO_SHIFT) - 1)
+
+static inline uint32_t range_entry_base_mtrr_addr(struct range_entry *r)
+{
+	return PHYS_TO_RANGE_ADDR(range_entry_base(r));
+}
+
+static inline uint32_t range_entry_end_mtrr_addr(struct range_entry *r)
+{
+	return PHYS_TO_RANGE_ADDR(range_entry_end(r));
+}
+
+static inline int range_entry_mtrr_type(struct range_entry *r)
+{
+	return range_entry_tag(r) & MTRR_TAG_MASK;
+}
+
+struct var_mtrr_regs {
+	msr_t base;
+	msr_t mask;
+};
+
+struct var_mtrr_solution {
+	int mtrr_default_type;
+	int num_used;
+	struct var_mtrr_regs regs[NUM_MTRR_STATIC_STORAGE];
+};
+
+/* Number of variable MTRRs in total and of those left to the firmware. */
+extern int total_mtrrs;
+extern int bios_mtrrs;
+
+/* Returns the default MTRR type that needs the fewest variable MTRRs. */
+int calc_var_mtrrs(struct memranges *addr_space, int above4gb, int address_bits);
+
+/* Fills `sol` with the variable MTRRs for `def_type` as default type. */
+void prepare_var_mtrrs(struct memranges *addr_space, int def_type,
+		       int above4gb, int address_bits,
+		       struct var_mtrr_solution *sol);
+
+#endif /* CPU_X86_MTRR_VAR_MTRR_H */
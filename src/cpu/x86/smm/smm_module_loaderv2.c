@@ -149,19 +149,20 @@ static int smm_create_map(uintptr_t smbase, unsigned int num_cpus,
 		}
 	}
 
-	if (CONFIG_DEFAULT_CONSOLE_LOGLEVEL >= BIOS_DEBUG) {
+	/* Several lines per CPU add up on a slow console with many CPUs. */
+	if (CONFIG_DEFAULT_CONSOLE_LOGLEVEL >= BIOS_SPEW) {
 		seg_count = 0;
 		for (i = 0; i < num_cpus; i++) {
-			printk(BIOS_DEBUG, "CPU 0x%x\n", i);
-			printk(BIOS_DEBUG,
+			printk(BIOS_SPEW, "CPU 0x%x\n", i);
+			printk(BIOS_SPEW,
 				"    smbase %zx  entry %zx\n",
 				cpus[i].smbase, cpus[i].entry);
-			printk(BIOS_DEBUG,
+			printk(BIOS_SPEW,
 				"           ss_start %zx  code_end %zx\n",
 				cpus[i].ss_start, cpus[i].code_end);
 			seg_count++;
 			if (seg_count >= cpus_in_segment) {
-				printk(BIOS_DEBUG,
+				printk(BIOS_SPEW,
 					"-------------NEW CODE SEGMENT --------------\n");
 				seg_count = 0;
 			}
@@ -246,12 +247,14 @@ static int smm_place_entry_code(uintptr_t smbase, unsigned int num_cpus,
 	size = cpus[0].code_end - cpus[0].code_start;
 	for (i = 1; i < num_cpus; i++) {
 		memcpy((int *)cpus[i].code_start, (int *)cpus[0].code_start, size);
-		printk(BIOS_DEBUG,
+		printk(BIOS_SPEW,
 			"SMM Module: placing smm entry code at %zx,  cpu # 0x%x\n",
 			cpus[i].code_start, i);
-		printk(BIOS_DEBUG, "%s: copying from %zx to %zx 0x%x bytes\n",
+		printk(BIOS_SPEW, "%s: copying from %zx to %zx 0x%x bytes\n",
 			__func__, cpus[0].code_start, cpus[i].code_start, size);
 	}
+	printk(BIOS_DEBUG, "SMM Module: placed 0x%x bytes of entry code for %u CPUs\n",
+		size, num_cpus);
 	return 1;
 }
 
@@ -7,6 +7,7 @@
 #include <device/pci.h>
 #include <device/pci_def.h>
 #include <device/resource.h>
+#include <static.h>
 
 /** Linked list of ALL devices */
 DEVTREE_CONST struct device * DEVTREE_CONST all_devices = &dev_root;
@@ -267,8 +268,34 @@ DEVTREE_CONST struct bus *pci_root_bus(void)
 	return pci_root;
 }
 
+/*
+ * Outside of ramstage the devicetree is constant and the PCI devices on the
+ * root bus can be looked up in the table sorted by devfn that sconfig emits.
+ * In ramstage, enumeration adds and removes devices on the root bus.
+ */
+static DEVTREE_CONST struct device *pcidev_path_on_root_sorted(pci_devfn_t devfn)
+{
+	size_t lo = 0, hi = __pci_0_device_count, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (__pci_0_devfns[mid] < devfn)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < __pci_0_device_count && __pci_0_devfns[lo] == devfn)
+		return __pci_0_devices[lo];
+
+	return NULL;
+}
+
 DEVTREE_CONST struct device *pcidev_path_on_root(pci_devfn_t devfn)
 {
+	if (DEVTREE_EARLY && __pci_0_device_count)
+		return pcidev_path_on_root_sorted(devfn);
+
 	return pcidev_path_behind(pci_root_bus(), devfn);
 }
 
@@ -8,6 +8,7 @@
 #include <acpi/acpi.h>
 #include <device/pci_ops.h>
 #include <bootmode.h>
+#include <bootstate.h>
 #include <console/console.h>
 #include <cpu/cpu.h>
 #include <stdlib.h>
@@ -930,6 +931,157 @@ static int device_id_match(struct pci_driver *driver, unsigned short device_id)
 	return (driver->device == device_id);
 }
 
+/*
+ * Open addressing hash of (vendor, device) to the index of the first matching
+ * driver in _pci_drivers, filled once on first use. It keeps the semantics of
+ * the linear walk over the linker set: the driver linked first wins. The table
+ * is sized from the number of IDs and allocated on the heap. If it would take
+ * too much of the heap, set_pci_ops() falls back to the linear walk. It is only
+ * needed while devices are enumerated and is freed afterwards.
+ */
+struct pci_driver_hash_entry {
+	uint16_t device;
+	uint16_t driver;	/* Index into _pci_drivers plus one, 0 if empty. */
+};
+
+static struct pci_driver_hash_entry *pci_driver_hash;
+static unsigned int pci_driver_hash_bits;
+static enum {
+	PCI_DRIVER_HASH_UNINIT,
+	PCI_DRIVER_HASH_READY,
+	PCI_DRIVER_HASH_OFF,
+} pci_driver_hash_state;
+
+static size_t pci_driver_hash_slot(uint16_t vendor, uint16_t device)
+{
+	return (((uint32_t)vendor << 16 | device) * 0x9e3779b1) >>
+		(32 - pci_driver_hash_bits);
+}
+
+static size_t pci_driver_hash_next(size_t slot)
+{
+	return (slot + 1) & ((1 << pci_driver_hash_bits) - 1);
+}
+
+static struct pci_driver *pci_driver_hash_lookup(uint16_t vendor, uint16_t device)
+{
+	size_t slot;
+
+	for (slot = pci_driver_hash_slot(vendor, device);
+	     pci_driver_hash[slot].driver != 0;
+	     slot = pci_driver_hash_next(slot)) {
+		struct pci_driver *driver = &_pci_drivers[pci_driver_hash[slot].driver - 1];
+
+		if (pci_driver_hash[slot].device == device && driver->vendor == vendor)
+			return driver;
+	}
+
+	return NULL;
+}
+
+static void pci_driver_hash_insert(size_t idx, uint16_t device)
+{
+	const struct pci_driver *driver = &_pci_drivers[idx];
+	const struct pci_driver *other;
+	size_t slot;
+
+	for (slot = pci_driver_hash_slot(driver->vendor, device);
+	     pci_driver_hash[slot].driver != 0;
+	     slot = pci_driver_hash_next(slot)) {
+		other = &_pci_drivers[pci_driver_hash[slot].driver - 1];
+		if (pci_driver_hash[slot].device == device &&
+		    other->vendor == driver->vendor) {
+			/* The same driver may list an ID twice, that is harmless. */
+			if (other != driver)
+				printk(BIOS_WARNING, "PCI: Duplicate driver for "
+				       "[%04x/%04x], using the first one.\n",
+				       driver->vendor, device);
+			return;
+		}
+	}
+
+	pci_driver_hash[slot].device = device;
+	pci_driver_hash[slot].driver = idx + 1;
+}
+
+/* Drivers that use a device list usually leave .device at 0. */
+static bool pci_driver_uses_device(const struct pci_driver *driver)
+{
+	return !driver->devices || driver->device != 0;
+}
+
+static void pci_driver_hash_init(void)
+{
+	const size_t num_drivers = &_epci_drivers[0] - &_pci_drivers[0];
+	const unsigned short *device_list;
+	size_t idx, num_ids = 0, size;
+
+	pci_driver_hash_state = PCI_DRIVER_HASH_OFF;
+	if (num_drivers >= UINT16_MAX)
+		return;
+
+	for (idx = 0; idx < num_drivers; idx++) {
+		device_list = _pci_drivers[idx].devices;
+		while (device_list && *device_list++ != 0)
+			num_ids++;
+		if (pci_driver_uses_device(&_pci_drivers[idx]))
+			num_ids++;
+	}
+
+	/* Keep the table at most half full, so probe sequences stay short. */
+	pci_driver_hash_bits = 4;
+	while ((1UL << pci_driver_hash_bits) < 2 * num_ids)
+		pci_driver_hash_bits++;
+
+	size = sizeof(*pci_driver_hash) << pci_driver_hash_bits;
+	if (pci_driver_hash_bits > 16 || size > CONFIG_HEAP_SIZE / 2) {
+		printk(BIOS_INFO, "PCI: Too many driver IDs (%zu) for the lookup table.\n",
+		       num_ids);
+		return;
+	}
+
+	pci_driver_hash = malloc(size);
+	memset(pci_driver_hash, 0, size);
+
+	for (idx = 0; idx < num_drivers; idx++) {
+		device_list = _pci_drivers[idx].devices;
+		while (device_list && *device_list != 0)
+			pci_driver_hash_insert(idx, *device_list++);
+		if (pci_driver_uses_device(&_pci_drivers[idx]))
+			pci_driver_hash_insert(idx, _pci_drivers[idx].device);
+	}
+
+	pci_driver_hash_state = PCI_DRIVER_HASH_READY;
+}
+
+/* Later lookups, e.g. for hot-plugged devices, use the linear walk. */
+static void pci_driver_hash_free(void *unused)
+{
+	free(pci_driver_hash);
+	pci_driver_hash = NULL;
+	pci_driver_hash_state = PCI_DRIVER_HASH_OFF;
+}
+
+BOOT_STATE_INIT_ENTRY(BS_DEV_ENUMERATE, BS_ON_EXIT, pci_driver_hash_free, NULL);
+
+static struct pci_driver *find_pci_driver(uint16_t vendor, uint16_t device)
+{
+	struct pci_driver *driver;
+
+	if (pci_driver_hash_state == PCI_DRIVER_HASH_UNINIT)
+		pci_driver_hash_init();
+
+	if (pci_driver_hash_state == PCI_DRIVER_HASH_READY)
+		return pci_driver_hash_lookup(vendor, device);
+
+	for (driver = &_pci_drivers[0]; driver != &_epci_drivers[0]; driver++) {
+		if ((driver->vendor == vendor) && device_id_match(driver, device))
+			return driver;
+	}
+
+	return NULL;
+}
+
 /**
  * Set up PCI device operation.
  *
@@ -950,15 +1102,13 @@ static void set_pci_ops(struct device *dev)
 	 * Look through the list of setup drivers and find one for
 	 * this PCI device.
 	 */
-	for (driver = &_pci_drivers[0]; driver != &_epci_drivers[0]; driver++) {
-		if ((driver->vendor == dev->vendor) &&
-		    device_id_match(driver, dev->device)) {
-			dev->ops = (struct device_operations *)driver->ops;
-			printk(BIOS_SPEW, "%s [%04x/%04x] %sops\n",
-			       dev_path(dev), driver->vendor, driver->device,
-			       (driver->ops->scan_bus ? "bus " : ""));
-			return;
-		}
+	driver = find_pci_driver(dev->vendor, dev->device);
+	if (driver) {
+		dev->ops = (struct device_operations *)driver->ops;
+		printk(BIOS_SPEW, "%s [%04x/%04x] %sops\n",
+		       dev_path(dev), driver->vendor, driver->device,
+		       (driver->ops->scan_bus ? "bus " : ""));
+		return;
 	}
 
 	/* If I don't have a specific driver use the default operations. */
@@ -1312,6 +1462,9 @@ void pci_scan_bus(struct bus *bus, unsigned int min_devfn,
 
 	scan_bridges(bus);
 
+	if (CONFIG(PCIEXP_PLUGIN_SUPPORT))
+		pciexp_wait_for_links(bus);
+
 	/*
 	 * We've scanned the bus and so we know all about what's on the other
 	 * side of any bridges that may be on this bus plus any devices.
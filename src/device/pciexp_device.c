@@ -7,6 +7,9 @@
 #include <device/pci.h>
 #include <device/pci_ops.h>
 #include <device/pciexp.h>
+#include <string.h>
+#include <timer.h>
+#include <timestamp.h>
 
 unsigned int pciexp_find_extended_cap(struct device *dev, unsigned int cap)
 {
@@ -35,7 +38,8 @@ unsigned int pciexp_find_extended_cap(struct device *dev, unsigned int cap)
  * Re-train a PCIe link
  */
 #define PCIE_TRAIN_RETRY 10000
-static int pciexp_retrain_link(struct device *dev, unsigned int cap)
+#define PCIE_TRAIN_TIMEOUT_US (PCIE_TRAIN_RETRY * 100)
+static int pciexp_start_link_retrain(struct device *dev, unsigned int cap)
 {
 	unsigned int try;
 	u16 lnk;
@@ -63,24 +67,45 @@ static int pciexp_retrain_link(struct device *dev, unsigned int cap)
 	lnk |= PCI_EXP_LNKCTL_RL;
 	pci_write_config16(dev, cap + PCI_EXP_LNKCTL, lnk);
 
-	/* Wait for training to complete */
-	for (try = PCIE_TRAIN_RETRY; try > 0; try--) {
-		lnk = pci_read_config16(dev, cap + PCI_EXP_LNKSTA);
-		if (!(lnk & PCI_EXP_LNKSTA_LT))
-			return 0;
-		udelay(100);
-	}
+	return 0;
+}
 
-	printk(BIOS_ERR, "%s: Link Retrain timeout\n", dev_path(dev));
-	return -1;
+static bool pciexp_link_training(struct device *dev, unsigned int cap)
+{
+	return pci_read_config16(dev, cap + PCI_EXP_LNKSTA) & PCI_EXP_LNKSTA_LT;
+}
+
+/*
+ * All devices below a root or downstream port share its link, so they are
+ * all functions of the same endpoint.
+ */
+static void pciexp_set_common_clock(struct device *endp)
+{
+	struct device *fn;
+	unsigned int cap;
+	u16 lnkctl;
+
+	for (fn = endp->bus->children; fn; fn = fn->sibling) {
+		if (fn->path.type != DEVICE_PATH_PCI || !fn->enabled)
+			continue;
+
+		cap = pci_find_capability(fn, PCI_CAP_ID_PCIE);
+		if (!cap)
+			continue;
+
+		lnkctl = pci_read_config16(fn, cap + PCI_EXP_LNKCTL);
+		lnkctl |= PCI_EXP_LNKCTL_CCC;
+		pci_write_config16(fn, cap + PCI_EXP_LNKCTL, lnkctl);
+	}
 }
 
 /*
  * Check the Slot Clock Configuration for root port and endpoint
  * and enable Common Clock Configuration if possible.  If CCC is
- * enabled the link must be retrained.
+ * enabled the link must be retrained. Returns true if retraining was
+ * started, the caller has to wait for it to complete.
  */
-static void pciexp_enable_common_clock(struct device *root, unsigned int root_cap,
+static bool pciexp_enable_common_clock(struct device *root, unsigned int root_cap,
 				       struct device *endp, unsigned int endp_cap)
 {
 	u16 root_scc, endp_scc, lnkctl;
@@ -95,12 +120,15 @@ static void pciexp_enable_common_clock(struct device *root, unsigned int root_ca
 
 	/* Enable Common Clock Configuration and retrain */
 	if (root_scc && endp_scc) {
+		/* Already set up through another function of the endpoint. */
+		if ((pci_read_config16(root, root_cap + PCI_EXP_LNKCTL) & PCI_EXP_LNKCTL_CCC) &&
+		    (pci_read_config16(endp, endp_cap + PCI_EXP_LNKCTL) & PCI_EXP_LNKCTL_CCC))
+			return false;
+
 		printk(BIOS_INFO, "Enabling Common Clock Configuration\n");
 
-		/* Set in endpoint */
-		lnkctl = pci_read_config16(endp, endp_cap + PCI_EXP_LNKCTL);
-		lnkctl |= PCI_EXP_LNKCTL_CCC;
-		pci_write_config16(endp, endp_cap + PCI_EXP_LNKCTL, lnkctl);
+		/* Set in all functions of the endpoint */
+		pciexp_set_common_clock(endp);
 
 		/* Set in root port */
 		lnkctl = pci_read_config16(root, root_cap + PCI_EXP_LNKCTL);
@@ -108,8 +136,10 @@ static void pciexp_enable_common_clock(struct device *root, unsigned int root_ca
 		pci_write_config16(root, root_cap + PCI_EXP_LNKCTL, lnkctl);
 
 		/* Retrain link if CCC was enabled */
-		pciexp_retrain_link(root, root_cap);
+		return pciexp_start_link_retrain(root, root_cap) == 0;
 	}
+
+	return false;
 }
 
 static void pciexp_enable_clock_power_pm(struct device *endp, unsigned int endp_cap)
@@ -438,6 +468,152 @@ static void pciexp_set_max_payload_size(struct device *root, unsigned int root_c
 	printk(BIOS_INFO, "PCIe: Max_Payload_Size adjusted to %d\n", (1 << (max_payload + 7)));
 }
 
+static void pciexp_finish_tune_dev(struct device *root, unsigned int root_cap,
+				   struct device *dev, unsigned int cap)
+{
+	/* Check if per port CLK req is supported by endpoint*/
+	if (CONFIG(PCIEXP_CLK_PM))
+		pciexp_enable_clock_power_pm(dev, cap);
+
+	/* Enable L1 Sub-State when both root port and endpoint support */
+	if (CONFIG(PCIEXP_L1_SUB_STATE))
+		pciexp_config_L1_sub_state(root, dev);
+
+	/* Check for and enable ASPM */
+	if (CONFIG(PCIEXP_ASPM))
+		pciexp_enable_aspm(root, root_cap, dev, cap);
+
+	/* Adjust Max_Payload_Size of link ends. */
+	pciexp_set_max_payload_size(root, root_cap, dev, cap);
+}
+
+/*
+ * Links that are retraining after Common Clock Configuration was enabled.
+ * Tuning of the endpoint and LTR setup of the port are finished once the
+ * link is back, in pciexp_wait_for_links(). That is called after all
+ * bridges on a bus are scanned, so the links of sibling ports train at
+ * the same time. Every function of a multi-function endpoint gets its own
+ * entry, but only the first one retrains the link.
+ */
+#define PCIEXP_MAX_TRAINING_LINKS 32
+
+static struct pciexp_training_link {
+	struct device *root;
+	unsigned int root_cap;
+	struct device *dev;
+	unsigned int cap;
+	struct stopwatch sw;
+	bool trained;
+	bool enable_ltr;
+} training_links[PCIEXP_MAX_TRAINING_LINKS];
+static size_t num_training_links;
+
+static bool pciexp_link_done(struct pciexp_training_link *link)
+{
+	if (link->trained)
+		return true;
+
+	if (pciexp_link_training(link->root, link->root_cap)) {
+		if (!stopwatch_expired(&link->sw))
+			return false;
+		printk(BIOS_ERR, "%s: Link Retrain timeout\n", dev_path(link->root));
+	} else {
+		printk(BIOS_DEBUG, "%s: Link retrained in %ld usecs\n",
+		       dev_path(link->root), stopwatch_duration_usecs(&link->sw));
+	}
+
+	link->trained = true;
+	return true;
+}
+
+void pciexp_wait_for_links(struct bus *bus)
+{
+	struct pciexp_training_link *link;
+	bool pending, retraining = false;
+	size_t i;
+
+	/* One timestamp pair for the whole wait, the links train in parallel. */
+	for (i = 0; i < num_training_links; i++) {
+		if (training_links[i].root->bus == bus && !training_links[i].trained)
+			retraining = true;
+	}
+	if (retraining)
+		timestamp_add_now(TS_PCIE_LINK_TRAIN_START);
+
+	do {
+		pending = false;
+		for (i = 0; i < num_training_links; i++) {
+			link = &training_links[i];
+			if (link->root->bus == bus && !pciexp_link_done(link))
+				pending = true;
+		}
+		/* With COOP_MULTITASKING this yields to other threads. */
+		if (pending)
+			udelay(100);
+	} while (pending);
+
+	if (retraining)
+		timestamp_add_now(TS_PCIE_LINK_TRAIN_END);
+
+	i = 0;
+	while (i < num_training_links) {
+		link = &training_links[i];
+		if (link->root->bus != bus) {
+			i++;
+			continue;
+		}
+
+		pciexp_finish_tune_dev(link->root, link->root_cap, link->dev, link->cap);
+		if (link->enable_ltr)
+			pciexp_enable_ltr(link->root);
+
+		/* Keep the order, functions of a device are finished in order. */
+		memmove(link, link + 1,
+			(--num_training_links - i) * sizeof(*link));
+	}
+}
+
+/* Find the last deferred link below root, it is finished last. */
+static struct pciexp_training_link *pciexp_find_training_link(struct device *root)
+{
+	size_t i;
+
+	for (i = num_training_links; i > 0; i--) {
+		if (training_links[i - 1].root == root)
+			return &training_links[i - 1];
+	}
+
+	return NULL;
+}
+
+/*
+ * Defer tuning of dev until the link below root is retrained. With `retrain`
+ * unset, an earlier function of the same endpoint already polls the link.
+ * Returns false if there is no room to defer.
+ */
+static bool pciexp_defer_tune_dev(struct device *root, unsigned int root_cap,
+				  struct device *dev, unsigned int cap, bool retrain)
+{
+	struct pciexp_training_link *link;
+
+	if (num_training_links == ARRAY_SIZE(training_links))
+		pciexp_wait_for_links(root->bus);
+
+	if (num_training_links == ARRAY_SIZE(training_links))
+		return false;
+
+	link = &training_links[num_training_links++];
+	link->root = root;
+	link->root_cap = root_cap;
+	link->dev = dev;
+	link->cap = cap;
+	if (retrain)
+		stopwatch_init_usecs_expire(&link->sw, PCIE_TRAIN_TIMEOUT_US);
+	link->trained = !retrain;
+	link->enable_ltr = false;
+	return true;
+}
+
 static void pciexp_tune_dev(struct device *dev)
 {
 	struct device *root = dev->bus->dev;
@@ -451,24 +627,25 @@ static void pciexp_tune_dev(struct device *dev)
 	if (!root_cap)
 		return;
 
-	/* Check for and enable Common Clock */
-	if (CONFIG(PCIEXP_COMMON_CLOCK))
-		pciexp_enable_common_clock(root, root_cap, dev, cap);
-
-	/* Check if per port CLK req is supported by endpoint*/
-	if (CONFIG(PCIEXP_CLK_PM))
-		pciexp_enable_clock_power_pm(dev, cap);
+	/* Another function of this endpoint is still retraining the link. */
+	if (pciexp_find_training_link(root) &&
+	    pciexp_defer_tune_dev(root, root_cap, dev, cap, false))
+		return;
 
-	/* Enable L1 Sub-State when both root port and endpoint support */
-	if (CONFIG(PCIEXP_L1_SUB_STATE))
-		pciexp_config_L1_sub_state(root, dev);
+	/* Check for and enable Common Clock */
+	if (CONFIG(PCIEXP_COMMON_CLOCK) &&
+	    pciexp_enable_common_clock(root, root_cap, dev, cap)) {
+		if (pciexp_defer_tune_dev(root, root_cap, dev, cap, true))
+			return;
 
-	/* Check for and enable ASPM */
-	if (CONFIG(PCIEXP_ASPM))
-		pciexp_enable_aspm(root, root_cap, dev, cap);
+		/* No room to defer, wait for this link right here. */
+		timestamp_add_now(TS_PCIE_LINK_TRAIN_START);
+		if (!wait_us(PCIE_TRAIN_TIMEOUT_US, !pciexp_link_training(root, root_cap)))
+			printk(BIOS_ERR, "%s: Link Retrain timeout\n", dev_path(root));
+		timestamp_add_now(TS_PCIE_LINK_TRAIN_END);
+	}
 
-	/* Adjust Max_Payload_Size of link ends. */
-	pciexp_set_max_payload_size(root, root_cap, dev, cap);
+	pciexp_finish_tune_dev(root, root_cap, dev, cap);
 }
 
 void pciexp_scan_bus(struct bus *bus, unsigned int min_devfn,
@@ -486,10 +663,60 @@ void pciexp_scan_bus(struct bus *bus, unsigned int min_devfn,
 	}
 }
 
+/*
+ * Root ports and downstream ports have a single device on their link. Unless
+ * ARI forwarding is enabled, configuration requests for devices 1 to 31 are
+ * not forwarded and probing them only costs time.
+ */
+static bool pciexp_link_has_one_device(struct device *dev)
+{
+	unsigned int cap;
+	u16 flags;
+
+	if (!CONFIG(PCIEXP_SCAN_DEVICE_0_ONLY))
+		return false;
+
+	cap = pci_find_capability(dev, PCI_CAP_ID_PCIE);
+	if (!cap)
+		return false;
+
+	flags = pci_read_config16(dev, cap + PCI_EXP_FLAGS);
+	switch ((flags & PCI_EXP_FLAGS_TYPE) >> 4) {
+	case PCI_EXP_TYPE_ROOT_PORT:
+	case PCI_EXP_TYPE_DOWNSTREAM:
+		break;
+	default:
+		return false;
+	}
+
+	if ((flags & PCI_EXP_FLAGS_VERS) >= 2 &&
+	    (pci_read_config16(dev, cap + PCI_EXP_DEVCTL2) & PCI_EXP_DEVCTL2_ARI))
+		return false;
+
+	return true;
+}
+
+static void pciexp_scan_device_0(struct bus *bus, unsigned int min_devfn,
+				 unsigned int max_devfn)
+{
+	pciexp_scan_bus(bus, min_devfn, MIN(max_devfn, PCI_DEVFN(0, 7)));
+}
+
 void pciexp_scan_bridge(struct device *dev)
 {
-	do_pci_scan_bridge(dev, pciexp_scan_bus);
-	pciexp_enable_ltr(dev);
+	struct pciexp_training_link *link;
+
+	if (pciexp_link_has_one_device(dev))
+		do_pci_scan_bridge(dev, pciexp_scan_device_0);
+	else
+		do_pci_scan_bridge(dev, pciexp_scan_bus);
+
+	/* LTR setup has to wait until the link below is retrained. */
+	link = pciexp_find_training_link(dev);
+	if (link)
+		link->enable_ltr = true;
+	else
+		pciexp_enable_ltr(dev);
 }
 
 /** Default device operations for PCI Express bridges */
@@ -367,6 +367,8 @@ static void allocate_child_resources(struct bus *bus, struct memranges *ranges,
 {
 	struct resource *resource = NULL;
 	const struct device *dev;
+	const enum memranges_fit fit = CONFIG(RESOURCE_ALLOCATOR_V4_BEST_FIT) ?
+				       MEMRANGES_BEST_FIT : MEMRANGES_FIRST_FIT;
 
 	while ((dev = largest_resource(bus, &resource, type_mask, type_match))) {
 
@@ -374,7 +376,7 @@ static void allocate_child_resources(struct bus *bus, struct memranges *ranges,
 			continue;
 
 		if (memranges_steal(ranges, resource->limit, resource->size, resource->align,
-				    type_match, &resource->base) == false) {
+				    type_match, fit, &resource->base) == false) {
 			printk(BIOS_ERR, "  ERROR: Resource didn't fit!!! ");
 			printk(BIOS_DEBUG, "  %s %02lx *  size: 0x%llx limit: %llx %s\n",
 			       dev_path(dev), resource->index,
@@ -392,6 +394,33 @@ static void allocate_child_resources(struct bus *bus, struct memranges *ranges,
 	}
 }
 
+/* Return the free space left in all ranges with the given tag. */
+static resource_t memranges_free_space(const struct memranges *ranges, unsigned long tag)
+{
+	const struct range_entry *r;
+	resource_t free_space = 0;
+
+	memranges_each_entry(r, ranges) {
+		if (range_entry_tag(r) == tag)
+			free_space += range_entry_size(r);
+	}
+
+	return free_space;
+}
+
+static void print_domain_mem_usage(const struct device *domain,
+				   const struct memranges *ranges,
+				   resource_t below_4g, resource_t above_4g)
+{
+	resource_t below_4g_left = memranges_free_space(ranges, IORESOURCE_MEM);
+	resource_t above_4g_left = memranges_free_space(ranges,
+							IORESOURCE_MEM | IORESOURCE_ABOVE_4G);
+
+	printk(BIOS_INFO, "%s mem: below 4G 0x%llx of 0x%llx used, above 4G 0x%llx of 0x%llx used\n",
+	       dev_path(domain), below_4g - below_4g_left, below_4g,
+	       above_4g - above_4g_left, above_4g);
+}
+
 static void update_constraints(struct memranges *ranges, const struct device *dev,
 			      const struct resource *res)
 {
@@ -598,13 +627,18 @@ static void allocate_domain_resources(const struct device *domain)
 	 */
 	res = find_domain_resource(domain, IORESOURCE_MEM);
 	if (res) {
+		resource_t below_4g, above_4g;
+
 		setup_resource_ranges(domain, res, IORESOURCE_MEM, &ranges);
+		below_4g = memranges_free_space(&ranges, IORESOURCE_MEM);
+		above_4g = memranges_free_space(&ranges, IORESOURCE_MEM | IORESOURCE_ABOVE_4G);
 		allocate_child_resources(domain->link_list, &ranges,
 					 IORESOURCE_TYPE_MASK | IORESOURCE_ABOVE_4G,
 					 IORESOURCE_MEM);
 		allocate_child_resources(domain->link_list, &ranges,
 					 IORESOURCE_TYPE_MASK | IORESOURCE_ABOVE_4G,
 					 IORESOURCE_MEM | IORESOURCE_ABOVE_4G);
+		print_domain_mem_usage(domain, &ranges, below_4g, above_4g);
 		cleanup_resource_ranges(domain, &ranges, res);
 	}
 
@@ -264,34 +264,30 @@ static int elog_is_header_valid(void)
 }
 
 /*
- * Validate the event header and data.
+ * Validate the event header and data at the given offset in the mapped
+ * buffer. Returns the length of the event if valid, 0 otherwise.
  */
-static size_t elog_is_event_valid(size_t offset)
+static size_t elog_is_event_valid(uint8_t *buffer, size_t offset, size_t size)
 {
 	uint8_t checksum;
 	struct event_header *event;
-	uint8_t len;
-	const size_t len_offset = offsetof(struct event_header, length);
-	const size_t size = sizeof(len);
+	size_t len;
 
-	/* Read and validate length. */
-	if (rdev_readat(mirror_dev_get(), &len, offset + len_offset, size) < 0)
+	if (size - offset < sizeof(*event) + sizeof(checksum))
 		return 0;
 
+	event = (struct event_header *)&buffer[offset];
+	len = event->length;
+
 	/* Event length must be at least header size + checksum */
 	if (len < (sizeof(*event) + sizeof(checksum)))
 		return 0;
 
-	if (len > MAX_EVENT_SIZE)
-		return 0;
-
-	event = elog_get_event_buffer(offset, len);
-	if (!event)
+	if (len > MAX_EVENT_SIZE || len > size - offset)
 		return 0;
 
 	/* If event checksum is invalid the area is corrupt */
 	checksum = elog_checksum_event(event);
-	elog_put_event_buffer(event);
 
 	if (checksum != 0)
 		return 0;
@@ -344,36 +340,42 @@ static void elog_nv_erase(void)
 
 /*
  * Scan the event area and validate each entry and update the ELOG state.
+ * The events and the free space after them are checked in a single pass
+ * over the mirror.
  */
 static int elog_update_event_buffer_state(void)
 {
+	const struct region_device *rdev = mirror_dev_get();
+	const size_t size = region_device_sz(rdev);
 	size_t offset = elog_events_start();
+	uint8_t *buffer;
+	int ret = -1;
 
 	elog_debug("elog_update_event_buffer_state()\n");
 
+	buffer = rdev_mmap_full(rdev);
+	if (buffer == NULL)
+		return -1;
+
 	/* Go through each event and validate it */
 	while (1) {
-		uint8_t type;
-		const size_t type_offset = offsetof(struct event_header, type);
 		size_t len;
-		const size_t size = sizeof(type);
 
-		if (rdev_readat(mirror_dev_get(), &type,
-				offset + type_offset, size) < 0) {
-			return -1;
-		}
+		if (offset >= size)
+			goto out;
 
 		/* The end of the event marker has been found */
-		if (type == ELOG_TYPE_EOL)
+		if (buffer[offset + offsetof(struct event_header, type)] ==
+		    ELOG_TYPE_EOL)
 			break;
 
 		/* Validate the event */
-		len = elog_is_event_valid(offset);
+		len = elog_is_event_valid(buffer, offset, size);
 
 		if (!len) {
 			printk(BIOS_ERR, "ELOG: Invalid event @ offset 0x%zx\n",
 				offset);
-			return -1;
+			goto out;
 		}
 
 		/* Move to the next event */
@@ -382,13 +384,18 @@ static int elog_update_event_buffer_state(void)
 	}
 
 	/* Ensure the remaining buffer is empty */
-	if (!elog_is_buffer_clear(offset)) {
-		printk(BIOS_ERR, "ELOG: buffer not cleared from 0x%zx\n",
-			offset);
-		return -1;
+	for (size_t i = offset; i < size; i++) {
+		if (buffer[i] != ELOG_TYPE_EOL) {
+			printk(BIOS_ERR, "ELOG: buffer not cleared from 0x%zx\n",
+				offset);
+			goto out;
+		}
 	}
 
-	return 0;
+	ret = 0;
+out:
+	rdev_munmap(rdev, buffer);
+	return ret;
 }
 
 static int elog_scan_flash(void)
@@ -21,6 +21,16 @@
 #define UNIFIED_MRC_CACHE	"UNIFIED_MRC_CACHE"
 
 #define MRC_DATA_SIGNATURE       (('M'<<0)|('R'<<8)|('C'<<16)|('D'<<24))
+#define MRC_DELTA_SIGNATURE      (('M'<<0)|('R'<<8)|('C'<<16)|('P'<<24))
+
+/* Largest delta update written instead of the full data. */
+#define MRC_DELTA_MAX_SIZE	(8 * KiB)
+/* Differing bytes closer than this are merged into the same run. */
+#define MRC_DELTA_RUN_GAP	8
+
+/* Data is checksummed and hashed in chunks of this size. Keep it even so the
+ * partial IP checksums can be combined without byte swapping. */
+#define MRC_DATA_CHUNK_SIZE	(16 * KiB)
 
 struct mrc_metadata {
 	uint32_t signature;
@@ -30,6 +40,25 @@ struct mrc_metadata {
 	uint32_t version;
 } __packed;
 
+/*
+ * With MRC_CACHE_DELTA_UPDATES, a training data update can be stored as a
+ * delta against the last full update in the region, called the base. The
+ * delta update has a regular struct mrc_metadata header with the
+ * MRC_DELTA_SIGNATURE. Its data is a struct mrc_delta followed by the runs of
+ * bytes that differ from the base, each preceded by a struct mrc_delta_run.
+ */
+struct mrc_delta {
+	uint32_t base_offset;		/* Offset of the base in the region */
+	uint32_t base_size;		/* Data size of the base */
+	uint16_t base_checksum;		/* Data checksum of the base */
+	uint16_t result_checksum;	/* Data checksum with the delta applied */
+} __packed;
+
+struct mrc_delta_run {
+	uint32_t offset;
+	uint32_t size;
+} __packed;
+
 enum result {
 	UPDATE_FAILURE		= -1,
 	UPDATE_SUCCESS		= 0,
@@ -138,7 +167,9 @@ static int mrc_header_valid(struct region_device *rdev, struct mrc_metadata *md)
 		return -1;
 	}
 
-	if (md->signature != MRC_DATA_SIGNATURE) {
+	if (md->signature != MRC_DATA_SIGNATURE &&
+	    !(CONFIG(MRC_CACHE_DELTA_UPDATES) &&
+	      md->signature == MRC_DELTA_SIGNATURE)) {
 		printk(BIOS_ERR, "MRC: invalid header signature\n");
 		return -1;
 	}
@@ -169,6 +200,70 @@ static int mrc_header_valid(struct region_device *rdev, struct mrc_metadata *md)
 	return 0;
 }
 
+/* SHA-256 of the data last validated, see mrc_cache_data_sha256(). */
+static struct {
+	const void *data;
+	size_t size;
+	uint8_t digest[VB2_SHA256_DIGEST_SIZE];
+} data_sha256;
+
+static bool mrc_data_needs_sha256(void)
+{
+	return CONFIG(MRC_CACHE_DATA_SHA256) && ENV_ROMSTAGE &&
+		vboot_recovery_mode_enabled();
+}
+
+/*
+ * Compute the IP checksum of the data. If its SHA-256 will be needed too,
+ * compute it in the same pass so the data is only read once.
+ */
+static uint16_t mrc_data_checksum(const void *data, size_t data_size)
+{
+	struct vb2_digest_context ctx;
+	unsigned long checksum;
+	bool sha256 = mrc_data_needs_sha256();
+	size_t offset;
+
+	if (!sha256)
+		return compute_ip_checksum(data, data_size);
+
+	data_sha256.data = NULL;
+	if (vb2_digest_init(&ctx, VB2_HASH_SHA256))
+		sha256 = false;
+
+	/* Checksum of no data */
+	checksum = 0xffff;
+
+	for (offset = 0; offset < data_size; offset += MRC_DATA_CHUNK_SIZE) {
+		const uint8_t *chunk = (const uint8_t *)data + offset;
+		size_t size = MIN(data_size - offset, MRC_DATA_CHUNK_SIZE);
+
+		checksum = add_ip_checksums(offset, checksum,
+					    compute_ip_checksum(chunk, size));
+		if (sha256 && vb2_digest_extend(&ctx, chunk, size))
+			sha256 = false;
+	}
+
+	if (sha256 && !vb2_digest_finalize(&ctx, data_sha256.digest,
+					   sizeof(data_sha256.digest))) {
+		data_sha256.data = data;
+		data_sha256.size = data_size;
+	}
+
+	return checksum;
+}
+
+const uint8_t *mrc_cache_data_sha256(const void *data, size_t size)
+{
+	if (!mrc_data_needs_sha256())
+		return NULL;
+
+	if (data_sha256.data != data || data_sha256.size != size)
+		return NULL;
+
+	return data_sha256.digest;
+}
+
 static int mrc_data_valid(const struct mrc_metadata *md,
 			  void *data, size_t data_size)
 {
@@ -177,7 +272,7 @@ static int mrc_data_valid(const struct mrc_metadata *md,
 	if (md->data_size != data_size)
 		return -1;
 
-	checksum = compute_ip_checksum(data, data_size);
+	checksum = mrc_data_checksum(data, data_size);
 
 	if (md->data_checksum != checksum) {
 		printk(BIOS_ERR, "MRC: data checksum mismatch: %x vs %x\n",
@@ -188,6 +283,82 @@ static int mrc_data_valid(const struct mrc_metadata *md,
 	return 0;
 }
 
+/*
+ * Rebuild the data of a delta update from its base into buf. rdev covers the
+ * delta update, including metadata, and the base is looked up in
+ * backing_rdev. On success md describes the rebuilt data like a full update.
+ */
+static int mrc_delta_apply(const struct region_device *backing_rdev,
+			   const struct region_device *rdev,
+			   struct mrc_metadata *md, uint8_t *buf,
+			   size_t buf_size)
+{
+	struct region_device base_rdev;
+	struct mrc_metadata base_md;
+	struct mrc_delta delta;
+	struct mrc_delta_run run;
+	uint8_t *payload;
+	size_t offset;
+	int ret = -1;
+
+	payload = rdev_mmap(rdev, sizeof(*md), md->data_size);
+	if (payload == NULL)
+		return -1;
+
+	if (mrc_data_valid(md, payload, md->data_size) < 0 ||
+	    md->data_size < sizeof(delta))
+		goto out;
+
+	memcpy(&delta, payload, sizeof(delta));
+
+	if (delta.base_size > buf_size)
+		goto out;
+
+	if (rdev_chain(&base_rdev, backing_rdev, delta.base_offset,
+		       sizeof(base_md) + delta.base_size))
+		goto out;
+
+	if (mrc_header_valid(&base_rdev, &base_md) < 0 ||
+	    base_md.signature != MRC_DATA_SIGNATURE ||
+	    base_md.version != md->version ||
+	    base_md.data_checksum != delta.base_checksum) {
+		printk(BIOS_ERR, "MRC: base of delta update is gone\n");
+		goto out;
+	}
+
+	if (rdev_readat(&base_rdev, buf, sizeof(base_md), delta.base_size) !=
+	    delta.base_size)
+		goto out;
+
+	if (mrc_data_valid(&base_md, buf, delta.base_size) < 0)
+		goto out;
+
+	for (offset = sizeof(delta); offset < md->data_size;
+	     offset += run.size) {
+		if (md->data_size - offset < sizeof(run))
+			goto out;
+		memcpy(&run, &payload[offset], sizeof(run));
+		offset += sizeof(run);
+
+		if (run.size > md->data_size - offset ||
+		    run.offset > delta.base_size ||
+		    run.size > delta.base_size - run.offset)
+			goto out;
+		memcpy(&buf[run.offset], &payload[offset], run.size);
+	}
+
+	memset(md, 0, sizeof(*md));
+	md->signature = MRC_DATA_SIGNATURE;
+	md->data_size = delta.base_size;
+	md->version = base_md.version;
+	md->data_checksum = delta.result_checksum;
+	md->header_checksum = compute_ip_checksum(md, sizeof(*md));
+	ret = 0;
+out:
+	rdev_munmap(rdev, payload);
+	return ret;
+}
+
 static int mrc_cache_get_latest_slot_info(const char *name,
 				const struct region_device *backing_rdev,
 				struct mrc_metadata *md,
@@ -221,9 +392,14 @@ static int mrc_cache_get_latest_slot_info(const char *name,
 	return 0;
 }
 
+/*
+ * Find the current data for type. A delta update is rebuilt into buffer,
+ * which returns 1, as it can't be read from the boot device as is.
+ */
 static int mrc_cache_find_current(int type, uint32_t version,
 				  struct region_device *rdev,
-				  struct mrc_metadata *md)
+				  struct mrc_metadata *md,
+				  void *buffer, size_t buffer_size)
 {
 	const struct cache_region *cr;
 	struct region region;
@@ -255,6 +431,18 @@ static int mrc_cache_find_current(int type, uint32_t version,
 		return -1;
 	}
 
+	if (CONFIG(MRC_CACHE_DELTA_UPDATES) &&
+	    md->signature == MRC_DELTA_SIGNATURE) {
+		if (buffer == NULL) {
+			printk(BIOS_ERR, "MRC: no buffer to rebuild delta update\n");
+			return -1;
+		}
+		if (mrc_delta_apply(&read_rdev, rdev, md, buffer,
+				    buffer_size) < 0)
+			return -1;
+		return 1;
+	}
+
 	/* Re-size rdev to only contain the data. i.e. remove metadata. */
 	data_size = md->data_size;
 	return rdev_chain(rdev, rdev, md_size, data_size);
@@ -266,16 +454,22 @@ int mrc_cache_load_current(int type, uint32_t version, void *buffer,
 	struct region_device rdev;
 	struct mrc_metadata md;
 	size_t data_size;
+	int ret;
 
-	if (mrc_cache_find_current(type, version, &rdev, &md) < 0)
+	ret = mrc_cache_find_current(type, version, &rdev, &md, buffer,
+				     buffer_size);
+	if (ret < 0)
 		return -1;
 
-	data_size = region_device_sz(&rdev);
-	if (buffer_size < data_size)
-		return -1;
+	data_size = md.data_size;
 
-	if (rdev_readat(&rdev, buffer, 0, data_size) != data_size)
-		return -1;
+	if (ret == 0) {
+		if (buffer_size < data_size)
+			return -1;
+
+		if (rdev_readat(&rdev, buffer, 0, data_size) != data_size)
+			return -1;
+	}
 
 	if (mrc_data_valid(&md, buffer, data_size) < 0)
 		return -1;
@@ -291,7 +485,7 @@ void *mrc_cache_current_mmap_leak(int type, uint32_t version,
 	size_t region_device_size;
 	struct mrc_metadata md;
 
-	if (mrc_cache_find_current(type, version, &rdev, &md) < 0)
+	if (mrc_cache_find_current(type, version, &rdev, &md, NULL, 0) < 0)
 		return NULL;
 
 	region_device_size = region_device_sz(&rdev);
@@ -330,6 +524,210 @@ static bool mrc_cache_needs_update(const struct region_device *rdev,
 	return need_update;
 }
 
+/*
+ * Build a delta update turning base into the new data described by new_md.
+ * Returns the size of the delta update, or 0 if it doesn't fit in out.
+ */
+static size_t mrc_delta_build(uint8_t *out, size_t out_size,
+			      const struct mrc_metadata *new_md,
+			      const struct mrc_metadata *base_md,
+			      const uint8_t *base, size_t base_offset)
+{
+	const uint8_t *data = (const uint8_t *)&new_md[1];
+	const size_t size = new_md->data_size;
+	struct mrc_metadata md;
+	struct mrc_delta delta;
+	struct mrc_delta_run run;
+	size_t offset = sizeof(md) + sizeof(delta);
+	size_t i = 0;
+
+	if (out_size < offset)
+		return 0;
+
+	while (i < size) {
+		size_t end, j;
+
+		if (base[i] == data[i]) {
+			i++;
+			continue;
+		}
+
+		/* Extend the run until MRC_DELTA_RUN_GAP bytes in a row are
+		 * unchanged. */
+		end = i + 1;
+		for (j = end; j < size && j - end < MRC_DELTA_RUN_GAP; j++) {
+			if (base[j] != data[j])
+				end = j + 1;
+		}
+
+		run.offset = i;
+		run.size = end - i;
+		if (out_size - offset < sizeof(run) + run.size)
+			return 0;
+
+		memcpy(&out[offset], &run, sizeof(run));
+		offset += sizeof(run);
+		memcpy(&out[offset], &data[i], run.size);
+		offset += run.size;
+		i = end;
+	}
+
+	delta.base_offset = base_offset;
+	delta.base_size = base_md->data_size;
+	delta.base_checksum = base_md->data_checksum;
+	delta.result_checksum = new_md->data_checksum;
+	memcpy(&out[sizeof(md)], &delta, sizeof(delta));
+
+	memset(&md, 0, sizeof(md));
+	md.signature = MRC_DELTA_SIGNATURE;
+	md.data_size = offset - sizeof(md);
+	md.version = new_md->version;
+	md.data_checksum = compute_ip_checksum(&out[sizeof(md)], md.data_size);
+	md.header_checksum = compute_ip_checksum(&md, sizeof(md));
+	memcpy(out, &md, sizeof(md));
+
+	return offset;
+}
+
+/*
+ * Check that the base described by base_md is still intact at base_offset,
+ * reading it through rdev in chunks of buf_size.
+ */
+static bool mrc_delta_base_intact(const struct region_device *rdev,
+				  size_t base_offset,
+				  const struct mrc_metadata *base_md,
+				  uint8_t *buf, size_t buf_size)
+{
+	struct region_device base_rdev;
+	struct mrc_metadata md;
+	unsigned long checksum;
+	size_t offset, size;
+
+	if (rdev_chain(&base_rdev, rdev, base_offset,
+		       sizeof(md) + base_md->data_size) ||
+	    mrc_header_valid(&base_rdev, &md) < 0 ||
+	    memcmp(&md, base_md, sizeof(md)))
+		return false;
+
+	/* Checksum of no data */
+	checksum = 0xffff;
+
+	for (offset = 0; offset < md.data_size; offset += size) {
+		size = MIN(md.data_size - offset, buf_size);
+		if (rdev_readat(&base_rdev, buf, sizeof(md) + offset, size) !=
+		    size)
+			return false;
+		checksum = add_ip_checksums(offset, checksum,
+					    compute_ip_checksum(buf, size));
+	}
+
+	return checksum == md.data_checksum;
+}
+
+/*
+ * Store the update as a delta against the base of the latest update, if the
+ * delta is small enough. Returns true if the update was handled, with the
+ * outcome in res, or false if a full update needs to be written. The base is
+ * verified through write_rdev after writing, as backing_rdev reads through
+ * the memory-mapped boot device, which may not reflect the write yet.
+ */
+static bool mrc_cache_update_delta(const struct region_device *backing_rdev,
+				   const struct region_device *write_rdev,
+				   struct region_file *cache_file,
+				   const struct region_device *latest_rdev,
+				   const struct cbmem_entry *to_be_updated,
+				   enum result *res)
+{
+	static uint8_t buf[MRC_DELTA_MAX_SIZE];
+	const struct mrc_metadata *new_md = cbmem_entry_start(to_be_updated);
+	struct region_device rdev = *latest_rdev;
+	struct region_device base_rdev;
+	struct mrc_metadata md;
+	struct mrc_metadata base_md;
+	struct mrc_delta delta;
+	size_t base_offset;
+	uint8_t *base;
+	size_t size;
+	bool up_to_date = false;
+
+	if (mrc_header_valid(&rdev, &md) < 0)
+		return false;
+
+	if (md.signature == MRC_DATA_SIGNATURE) {
+		/* Let the regular path handle unchanged data. */
+		if (!mrc_cache_needs_update(latest_rdev, to_be_updated))
+			return false;
+		base_offset = region_device_offset(latest_rdev) -
+			region_device_offset(backing_rdev);
+	} else {
+		if (rdev_readat(&rdev, &delta, sizeof(md), sizeof(delta)) !=
+		    sizeof(delta))
+			return false;
+		base_offset = delta.base_offset;
+	}
+
+	if (base_offset >= region_device_sz(backing_rdev) ||
+	    rdev_chain(&base_rdev, backing_rdev, base_offset,
+		       region_device_sz(backing_rdev) - base_offset) ||
+	    mrc_header_valid(&base_rdev, &base_md) < 0 ||
+	    base_md.signature != MRC_DATA_SIGNATURE)
+		return false;
+
+	if (base_md.version != new_md->version ||
+	    base_md.data_size != new_md->data_size ||
+	    sizeof(*new_md) + new_md->data_size != cbmem_entry_size(to_be_updated))
+		return false;
+
+	base = rdev_mmap(&base_rdev, sizeof(base_md), base_md.data_size);
+	if (base == NULL)
+		return false;
+	size = 0;
+	if (mrc_data_valid(&base_md, base, base_md.data_size) == 0)
+		size = mrc_delta_build(buf, sizeof(buf), new_md, &base_md, base,
+				       base_offset);
+	rdev_munmap(&base_rdev, base);
+
+	if (!size)
+		return false;
+
+	/* The delta is built the same way every time, so the data is
+	 * unchanged if the latest update is this very delta. */
+	if (md.signature == MRC_DELTA_SIGNATURE &&
+	    region_device_sz(&rdev) == size) {
+		base = rdev_mmap_full(&rdev);
+		if (base == NULL)
+			return false;
+		up_to_date = !memcmp(base, buf, size);
+		rdev_munmap(&rdev, base);
+		if (up_to_date) {
+			*res = ALREADY_UPTODATE;
+			return true;
+		}
+	}
+
+	printk(BIOS_DEBUG, "MRC: writing 0x%zx byte delta update.\n", size);
+
+	if (region_file_update_data(cache_file, buf, size) < 0) {
+		*res = UPDATE_FAILURE;
+		return true;
+	}
+
+	/* If the region had to be emptied to fit the delta, the base is gone
+	 * and the full data needs to be written after all. */
+	if (!mrc_delta_base_intact(write_rdev, base_offset, &base_md, buf,
+				   sizeof(buf))) {
+		printk(BIOS_DEBUG, "MRC: base was erased, writing full update.\n");
+		if (region_file_update_data(cache_file, new_md,
+				cbmem_entry_size(to_be_updated)) < 0) {
+			*res = UPDATE_FAILURE;
+			return true;
+		}
+	}
+
+	*res = UPDATE_SUCCESS;
+	return true;
+}
+
 static void log_event_cache_update(uint8_t slot, enum result res)
 {
 	const int type = ELOG_TYPE_MEM_CACHE_UPDATE;
@@ -370,6 +768,7 @@ static void update_mrc_cache_by_type(int type)
 	const struct region_device *backing_rdev;
 	struct region_device latest_rdev;
 	const bool fail_bad_data = false;
+	enum result res;
 
 	cr = lookup_region(&region, type);
 
@@ -411,6 +810,15 @@ static void update_mrc_cache_by_type(int type)
 
 		return;
 
+	if (CONFIG(MRC_CACHE_DELTA_UPDATES) && type == MRC_TRAINING_DATA &&
+	    mrc_cache_update_delta(backing_rdev, &write_rdev, &cache_file,
+				   &latest_rdev, to_be_updated, &res)) {
+		printk(BIOS_DEBUG, "MRC: delta update of '%s': %d\n", cr->name,
+		       res);
+		log_event_cache_update(cr->elog_slot, res);
+		return;
+	}
+
 	if (!mrc_cache_needs_update(&latest_rdev, to_be_updated)) {
 		printk(BIOS_DEBUG, "MRC: '%s' does not need update.\n", cr->name);
 		log_event_cache_update(cr->elog_slot, ALREADY_UPTODATE);
@@ -7,6 +7,7 @@
 #include <commonlib/region.h>
 #include <console/console.h>
 #include <smmstore.h>
+#include <string.h>
 #include <types.h>
 
 /*
@@ -31,6 +32,17 @@
  * crash/reboot could clear out all variables.
  */
 
+/*
+ * Offset of the end marker in the store, or -1 if unknown. This saves walking
+ * every record on each append, which made SMI latency grow with the amount of
+ * data in the store. It is checked against the flash contents before use so
+ * that changes underneath (eg. due to an update) trigger a rescan.
+ */
+static ssize_t store_end = -1;
+
+/* Records up to this size are written to flash with a single write. */
+#define SMMSTORE_RECORD_BUF_SIZE 4096
+
 static enum cb_err lookup_store_region(struct region *region)
 {
 	if (CONFIG(SMMSTORE_IN_CBFS)) {
@@ -121,12 +133,39 @@ int smmstore_read_region(void *buf, ssize_t *bufsize)
 	return 0;
 }
 
+static bool cached_end_valid(const struct region_device *store)
+{
+	uint32_t marker;
+
+	if (store_end < 0 || store_end + sizeof(marker) > region_device_sz(store))
+		return false;
+
+	/* The end marker must still be where it was... */
+	if (rdev_readat(store, &marker, store_end, sizeof(marker)) != sizeof(marker) ||
+	    marker != 0xffffffff)
+		return false;
+
+	/* ...and the store must not have been erased from under us. */
+	if (store_end > 0 && (rdev_readat(store, &marker, 0, sizeof(marker)) !=
+			      sizeof(marker) || marker == 0xffffffff))
+		return false;
+
+	return true;
+}
+
 static enum cb_err scan_end(struct region_device *store)
 {
 	/* scan for end */
 	ssize_t end = 0;
 	uint32_t k_sz, v_sz;
 	const ssize_t data_sz = region_device_sz(store);
+
+	if (cached_end_valid(store))
+		return rdev_chain(store, store, store_end, data_sz - store_end) ?
+			CB_ERR : CB_SUCCESS;
+
+	store_end = -1;
+
 	while (end < data_sz) {
 		/* make odd corner cases identifiable, eg. invalid v_sz */
 		k_sz = 0;
@@ -174,9 +213,44 @@ static enum cb_err scan_end(struct region_device *store)
 	if (rdev_chain(store, store, end, data_sz - end))
 		return CB_ERR;
 
+	store_end = end;
+
 	return CB_SUCCESS;
 
 }
+
+/*
+ * Write a record in one go. Since the active byte comes last and flash is
+ * programmed sequentially, an interrupted write still leaves an inactive
+ * entry.
+ *
+ * Returns 0 on success, -1 on failure
+ */
+static int write_record(const struct region_device *store, const void *key,
+			uint32_t key_sz, const void *value, uint32_t value_sz,
+			size_t size)
+{
+	static uint8_t buf[SMMSTORE_RECORD_BUF_SIZE];
+	size_t offset = 0;
+
+	memcpy(&buf[offset], &key_sz, sizeof(key_sz));
+	offset += sizeof(key_sz);
+	memcpy(&buf[offset], &value_sz, sizeof(value_sz));
+	offset += sizeof(value_sz);
+	memcpy(&buf[offset], key, key_sz);
+	offset += key_sz;
+	memcpy(&buf[offset], value, value_sz);
+	offset += value_sz;
+	buf[offset] = 0;
+
+	if (rdev_writeat(store, buf, 0, size) != size) {
+		printk(BIOS_WARNING, "failed writing record\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * Append data to region
  *
@@ -194,6 +268,7 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 
 	ssize_t offset = 0;
 	ssize_t size;
+	ssize_t end;
 	uint8_t nul = 0;
 	if (scan_end(&store) != CB_SUCCESS)
 		return -1;
@@ -203,6 +278,13 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 	printk(BIOS_DEBUG, "open (%zx, %zx) for writing\n",
 		region_device_offset(&store), region_device_sz(&store));
 
+	/* Neither part can exceed the store, so the sum below cannot wrap. */
+	if (key_sz > region_device_sz(&store) ||
+	    value_sz > region_device_sz(&store)) {
+		printk(BIOS_WARNING, "not enough space for new data\n");
+		return -1;
+	}
+
 	size = sizeof(key_sz) + sizeof(value_sz) + key_sz + value_sz
 		+ sizeof(nul);
 	if (rdev_chain(&store, &store, 0, size)) {
@@ -210,6 +292,20 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 		return -1;
 	}
 
+	/* Whatever happens next, the end marker moves. */
+	end = store_end;
+	store_end = -1;
+
+	/* Check the parts on their own as well, the buffer must not overflow. */
+	if (key_sz <= SMMSTORE_RECORD_BUF_SIZE &&
+	    value_sz <= SMMSTORE_RECORD_BUF_SIZE &&
+	    size <= SMMSTORE_RECORD_BUF_SIZE) {
+		if (write_record(&store, key, key_sz, value, value_sz, size) < 0)
+			return -1;
+		store_end = ALIGN_UP(end + size, sizeof(uint32_t));
+		return 0;
+	}
+
 	if (rdev_writeat(&store, &key_sz, offset, sizeof(key_sz))
 	    != sizeof(key_sz)) {
 		printk(BIOS_WARNING, "failed writing key size\n");
@@ -237,6 +333,8 @@ int smmstore_append_data(void *key, uint32_t key_sz, void *value,
 		return -1;
 	}
 
+	store_end = ALIGN_UP(end + size, sizeof(uint32_t));
+
 	return 0;
 }
 
@@ -254,11 +352,15 @@ int smmstore_clear_region(void)
 		return -1;
 	}
 
+	store_end = -1;
+
 	ssize_t res = rdev_eraseat(&store, 0, region_device_sz(&store));
 	if (res != region_device_sz(&store)) {
 		printk(BIOS_WARNING, "smm store: erasing region failed\n");
 		return -1;
 	}
 
+	store_end = 0;
+
 	return 0;
 }
@@ -36,7 +36,41 @@ struct vpd_gets_arg {
 	int matched;
 };
 
+/*
+ * Once the VPD is copied to CBMEM, an index of its keys is added next to it
+ * so that lookups don't need to decode the whole VPD again. The index is an
+ * open addressing hash table with linear probing, and its entries point into
+ * the blob of struct vpd_cbmem.
+ */
+enum {
+	VPD_INDEX_EMPTY = 0xffffffff,
+	VPD_INDEX_MIN_SLOTS = 16,
+};
+
+struct vpd_index_entry {
+	uint32_t hash;
+	uint32_t region;	/* VPD_RO, VPD_RW or VPD_INDEX_EMPTY */
+	uint32_t key_offset;
+	uint32_t key_len;
+	uint32_t value_offset;
+	uint32_t value_len;
+};
+
+struct vpd_index {
+	uint32_t num_slots;	/* Power of 2 */
+	uint32_t num_entries;
+	struct vpd_index_entry slots[];
+};
+
+struct vpd_index_arg {
+	struct vpd_index *index;
+	const uint8_t *blob;
+	enum vpd_region region;
+};
+
 static struct region_device ro_vpd, rw_vpd;
+static const struct vpd_cbmem *vpd_cbmem;
+static const struct vpd_index *vpd_index;
 
 /*
  * Initializes a region_device to represent the requested VPD 2.0 formatted
@@ -99,6 +133,9 @@ static int init_vpd_rdevs_from_cbmem(void)
 	if (!cbmem)
 		return -1;
 
+	vpd_cbmem = cbmem;
+	vpd_index = cbmem_find(CBMEM_ID_VPD_INDEX);
+
 	rdev_chain(&ro_vpd, &addrspace_32bit.rdev,
 		   (uintptr_t)cbmem->blob, cbmem->ro_size);
 	rdev_chain(&rw_vpd, &addrspace_32bit.rdev,
@@ -122,6 +159,131 @@ static void init_vpd_rdevs(void)
 	done = true;
 }
 
+/* 32-bit FNV-1a */
+static uint32_t vpd_hash(const uint8_t *key, uint32_t key_len)
+{
+	uint32_t hash = 2166136261;
+
+	while (key_len--) {
+		hash ^= *key++;
+		hash *= 16777619;
+	}
+
+	return hash;
+}
+
+static const struct vpd_index_entry *vpd_index_lookup(
+	const struct vpd_index *index, const uint8_t *blob,
+	const uint8_t *key, uint32_t key_len, uint32_t hash,
+	enum vpd_region region)
+{
+	const uint32_t mask = index->num_slots - 1;
+	uint32_t i;
+
+	for (i = hash & mask; index->slots[i].region != VPD_INDEX_EMPTY;
+	     i = (i + 1) & mask) {
+		const struct vpd_index_entry *e = &index->slots[i];
+
+		if (e->hash == hash && e->region == region &&
+		    e->key_len == key_len &&
+		    !memcmp(&blob[e->key_offset], key, key_len))
+			return e;
+	}
+
+	return NULL;
+}
+
+static int vpd_count_callback(const uint8_t *key, uint32_t key_len,
+			      const uint8_t *value, uint32_t value_len,
+			      void *arg)
+{
+	(*(size_t *)arg)++;
+	return VPD_DECODE_OK;
+}
+
+static int vpd_index_callback(const uint8_t *key, uint32_t key_len,
+			      const uint8_t *value, uint32_t value_len,
+			      void *arg)
+{
+	struct vpd_index_arg *ia = arg;
+	struct vpd_index *index = ia->index;
+	const uint32_t mask = index->num_slots - 1;
+	const uint32_t hash = vpd_hash(key, key_len);
+	struct vpd_index_entry *e;
+	uint32_t i;
+
+	/* Like vpd_find_in(), the first instance of a key wins. */
+	if (vpd_index_lookup(index, ia->blob, key, key_len, hash, ia->region))
+		return VPD_DECODE_OK;
+
+	/* Keep at least one slot free to terminate lookups. */
+	if (index->num_entries + 1 >= index->num_slots)
+		return VPD_DECODE_FAIL;
+
+	for (i = hash & mask; index->slots[i].region != VPD_INDEX_EMPTY;
+	     i = (i + 1) & mask)
+		;
+
+	e = &index->slots[i];
+	e->hash = hash;
+	e->region = ia->region;
+	e->key_offset = key - ia->blob;
+	e->key_len = key_len;
+	e->value_offset = value - ia->blob;
+	e->value_len = value_len;
+	index->num_entries++;
+
+	return VPD_DECODE_OK;
+}
+
+static void vpd_decode_all(const uint8_t *data, size_t size,
+			   vpd_decode_callback *callback, void *arg)
+{
+	uint32_t consumed = 0;
+
+	while (vpd_decode_string(size, data, &consumed, callback, arg) ==
+	       VPD_DECODE_OK) {
+	/* Iterate until failure or no more entries. */
+	}
+}
+
+/* Build the index for the VPD copy in CBMEM. */
+static void cbmem_add_vpd_index(const struct vpd_cbmem *cbmem)
+{
+	const uint8_t *ro = cbmem->blob;
+	const uint8_t *rw = cbmem->blob + cbmem->ro_size;
+	struct vpd_index_arg arg = { .blob = cbmem->blob };
+	struct vpd_index *index;
+	size_t num_keys = 0;
+	size_t num_slots = VPD_INDEX_MIN_SLOTS;
+	size_t i;
+
+	vpd_decode_all(ro, cbmem->ro_size, vpd_count_callback, &num_keys);
+	vpd_decode_all(rw, cbmem->rw_size, vpd_count_callback, &num_keys);
+
+	/* Keep the load factor at or below 1/2. */
+	while (num_slots < 2 * num_keys)
+		num_slots *= 2;
+
+	index = cbmem_add(CBMEM_ID_VPD_INDEX,
+			  sizeof(*index) + num_slots * sizeof(index->slots[0]));
+	if (!index) {
+		printk(BIOS_ERR, "%s: Failed to allocate CBMEM.\n", __func__);
+		return;
+	}
+
+	index->num_slots = num_slots;
+	index->num_entries = 0;
+	for (i = 0; i < num_slots; i++)
+		index->slots[i].region = VPD_INDEX_EMPTY;
+
+	arg.index = index;
+	arg.region = VPD_RO;
+	vpd_decode_all(ro, cbmem->ro_size, vpd_index_callback, &arg);
+	arg.region = VPD_RW;
+	vpd_decode_all(rw, cbmem->rw_size, vpd_index_callback, &arg);
+}
+
 static void cbmem_add_cros_vpd(int is_recovery)
 {
 	struct vpd_cbmem *cbmem;
@@ -166,6 +328,8 @@ static void cbmem_add_cros_vpd(int is_recovery)
 		timestamp_add_now(TS_END_COPYVPD_RW);
 	}
 
+	cbmem_add_vpd_index(cbmem);
+
 	init_vpd_rdevs_from_cbmem();
 }
 
@@ -186,17 +350,28 @@ static int vpd_gets_callback(const uint8_t *key, uint32_t key_len,
 	return VPD_DECODE_FAIL;
 }
 
-static void vpd_find_in(struct region_device *rdev, struct vpd_gets_arg *arg)
+static void vpd_find_in(struct region_device *rdev, struct vpd_gets_arg *arg,
+			enum vpd_region region)
 {
 	if (region_device_sz(rdev) == 0)
 		return;
 
-	uint32_t consumed = 0;
-	void *mapping = rdev_mmap_full(rdev);
-	while (vpd_decode_string(region_device_sz(rdev), mapping,
-		&consumed, vpd_gets_callback, arg) == VPD_DECODE_OK) {
-	/* Iterate until found or no more entries. */
+	if (vpd_index) {
+		const struct vpd_index_entry *e;
+
+		e = vpd_index_lookup(vpd_index, vpd_cbmem->blob, arg->key,
+				     arg->key_len,
+				     vpd_hash(arg->key, arg->key_len), region);
+		if (e) {
+			arg->matched = 1;
+			arg->value = &vpd_cbmem->blob[e->value_offset];
+			arg->value_len = e->value_len;
+		}
+		return;
 	}
+
+	void *mapping = rdev_mmap_full(rdev);
+	vpd_decode_all(mapping, region_device_sz(rdev), vpd_gets_callback, arg);
 	rdev_munmap(rdev, mapping);
 }
 
@@ -210,14 +385,14 @@ const void *vpd_find(const char *key, int *size, enum vpd_region region)
 	init_vpd_rdevs();
 
 	if (region == VPD_RW_THEN_RO)
-		vpd_find_in(&rw_vpd, &arg);
+		vpd_find_in(&rw_vpd, &arg, VPD_RW);
 
 	if (!arg.matched && (region == VPD_RO || region == VPD_RO_THEN_RW ||
 			region == VPD_RW_THEN_RO))
-		vpd_find_in(&ro_vpd, &arg);
+		vpd_find_in(&ro_vpd, &arg, VPD_RO);
 
 	if (!arg.matched && (region == VPD_RW || region == VPD_RO_THEN_RW))
-		vpd_find_in(&rw_vpd, &arg);
+		vpd_find_in(&rw_vpd, &arg, VPD_RW);
 
 	if (!arg.matched)
 		return NULL;
@@ -24,6 +24,9 @@ void pciexp_scan_bus(struct bus *bus, unsigned int min_devfn,
 
 void pciexp_scan_bridge(struct device *dev);
 
+/* Wait for links below the bridges on bus that retrain and finish their setup. */
+void pciexp_wait_for_links(struct bus *bus);
+
 extern struct device_operations default_pciexp_ops_bus;
 
 #if CONFIG(PCIEXP_HOTPLUG)
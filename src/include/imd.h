@@ -140,9 +140,15 @@ const struct imd_entry *imd_cursor_next(struct imd_cursor *cursor);
  * NOTE: Do not directly touch any fields within this structure. An imd pointer
  * is meant to be opaque, but the fields are exposed for stack allocation.
  */
+#define IMD_INDEX_SLOTS 128
+
 struct imdr {
 	uintptr_t limit;
 	void *r;
+	/* Entry id -> entry index hash, see imdr_index_sync(). */
+	void *index_root;
+	uint32_t index_entries;
+	uint8_t index[IMD_INDEX_SLOTS];
 };
 struct imd {
 	struct imdr lg;
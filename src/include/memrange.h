@@ -6,13 +6,16 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-/* A memranges structure consists of a list of range_entry(s). The structure
- * is exposed so that a memranges can be used on the stack if needed. */
+/* A memranges structure consists of an array of range_entry(s) sorted by
+ * address. The structure is exposed so that a memranges can be used on the
+ * stack if needed. */
 struct memranges {
 	struct range_entry *entries;
-	/* coreboot doesn't have a free() function. Therefore, keep a cache of
-	 * free'd entries.  */
-	struct range_entry *free_list;
+	size_t num_entries;
+	/* Number of entries the array has room for. */
+	size_t max_entries;
+	/* The array was allocated from the range pool, see memrange.c. */
+	bool pooled;
 	/* Alignment(log 2) for base and end addresses of the range. */
 	unsigned char align;
 };
@@ -25,7 +28,6 @@ struct range_entry {
 	resource_t begin;
 	resource_t end;
 	unsigned long tag;
-	struct range_entry *next;
 };
 
 /* Initialize a range_entry with inclusive beginning address and exclusive
@@ -37,7 +39,6 @@ static inline void range_entry_init(struct range_entry *re,
 	re->begin = incl_begin;
 	re->end = excl_end - 1;
 	re->tag = tag;
-	re->next = NULL;
 }
 
 /* Return inclusive base address of memory range. */
@@ -71,21 +72,24 @@ static inline void range_entry_update_tag(struct range_entry *r,
 
 static inline bool memranges_is_empty(const struct memranges *ranges)
 {
-	return ranges->entries == NULL;
+	return ranges->num_entries == 0;
 }
 
 /* Iterate over each entry in a memranges structure. Ranges cannot
- * be deleted while processing each entry as the list cannot be safely
- * traversed after such an operation.
+ * be added or deleted while processing each entry as the array cannot be
+ * safely traversed after such an operation.
  * r - range_entry pointer.
  * ranges - memranges pointer */
 #define memranges_each_entry(r, ranges) \
-	for (r = (ranges)->entries; r != NULL; r = r->next)
+	for (r = (ranges)->entries; \
+	     r != NULL && r < (ranges)->entries + (ranges)->num_entries; r++)
 
 
 /* Initialize memranges structure providing an optional array of range_entry
- * to use as the free list. Additionally, it accepts an align parameter that
- * represents the required alignment(log 2) of addresses. */
+ * to store the entries in. The array is replaced by a larger one from the
+ * range pool when it fills up, where the stage can allocate memory.
+ * Additionally, it accepts an align parameter that represents the required
+ * alignment(log 2) of addresses. */
 void memranges_init_empty_with_alignment(struct memranges *ranges,
 					 struct range_entry *free,
 					 size_t num_free, unsigned char align);
@@ -99,7 +103,7 @@ void memranges_init_with_alignment(struct memranges *ranges,
 		    unsigned long tag, unsigned char align);
 
 /* Initialize memranges structure providing an optional array of range_entry
- * to use as the free list. Addresses are default aligned to 4KiB(2^12). */
+ * to store the entries in. Addresses are default aligned to 4KiB(2^12). */
 #define memranges_init_empty(__ranges, __free, __num_free)	\
 	memranges_init_empty_with_alignment(__ranges, __free, __num_free, 12);
 
@@ -112,7 +116,8 @@ void memranges_init_with_alignment(struct memranges *ranges,
 /* Clone a memrange. The new memrange has the same entries as the old one. */
 void memranges_clone(struct memranges *newranges, struct memranges *oldranges);
 
-/* Remove and free all entries within the memranges structure. */
+/* Remove all entries within the memranges structure. An array allocated from
+ * the range pool is returned to it. */
 void memranges_teardown(struct memranges *ranges);
 
 /* Add memory resources that match with the corresponding mask and match.
@@ -161,16 +166,27 @@ void memranges_update_tag(struct memranges *ranges, unsigned long old_tag,
 struct range_entry *memranges_next_entry(struct memranges *ranges,
 					 const struct range_entry *r);
 
+/* Placement policies for memranges_steal(). */
+enum memranges_fit {
+	/* Use the lowest range the request fits in. */
+	MEMRANGES_FIRST_FIT,
+	/* Use the smallest range the request fits in, keeping large ranges
+	 * intact for large requests. Ties go to the lowest range. */
+	MEMRANGES_BEST_FIT,
+};
+
 /* Steals memory from the available list in given ranges as per the constraints:
  * limit = Upper bound for the memory range to steal (Inclusive).
  * size  = Requested size for the stolen memory.
  * align = Required alignment(log 2) for the starting address of the stolen memory.
  * tag   = Use a range that matches the given tag.
+ * fit   = Placement policy used to pick among the ranges that satisfy the above.
  *
  * If the constraints can be satisfied, this function creates a hole in the memrange,
  * writes the base address of that hole to stolen_base and returns true. Otherwise it returns
  * false. */
 bool memranges_steal(struct memranges *ranges, resource_t limit, resource_t size,
-			unsigned char align, unsigned long tag, resource_t *stolen_base);
+			unsigned char align, unsigned long tag, enum memranges_fit fit,
+			resource_t *stolen_base);
 
 #endif /* MEMRANGE_H_ */
@@ -41,6 +41,15 @@ int mrc_cache_load_current(int type, uint32_t version, void *buffer,
  */
 void *mrc_cache_current_mmap_leak(int type, uint32_t version,
 				  size_t *data_size);
+/**
+ * mrc_cache_data_sha256
+ *
+ * Return the SHA-256 digest computed while validating the given data in
+ * mrc_cache_load_current() or mrc_cache_current_mmap_leak(), or NULL if
+ * it is not available. Only computed with CONFIG(MRC_CACHE_DATA_SHA256) in
+ * recovery mode.
+ */
+const uint8_t *mrc_cache_data_sha256(const void *data, size_t size);
 /**
  * Returns < 0 on error, 0 on success.
  */
@@ -46,6 +46,8 @@ struct prog {
 	 * then it would represent the bounce buffer. */
 	enum prog_type type;
 	uint32_t cbfs_type;
+	/* Buffer size needed to decompress the stage in place, 0 if unknown. */
+	size_t cbfs_inplace_size;
 	const char *name;
 	struct region_device rdev;
 	/* Entry to program with optional argument. It's up to the architecture
@@ -41,11 +41,29 @@ static inline void stage_cache_get_raw(int stage_id, void **base, size_t *size)
 /* Fill in parameters for the external stage cache, if utilized. */
 void stage_cache_external_region(void **base, size_t *size);
 
+/* Compression value of an entry that could not be filled. */
+#define STAGE_CACHE_INVALID 0xffffffff
+
 /* Metadata associated with each stage. */
 struct stage_cache {
 	uint64_t load_addr;
 	uint64_t entry_addr;
 	uint64_t arg;
+	uint32_t compression;	/* CBFS_COMPRESS_NONE, CBFS_COMPRESS_LZ4 or
+				   STAGE_CACHE_INVALID */
+	uint32_t size;		/* Size of the stage once loaded */
+	uint32_t checksum;	/* IP checksum of the cache entry */
 };
 
+/* Helpers shared by the stage cache backends. stage_cache_prepare() fills in
+   the metadata for the stage and returns the size of the cache entry needed
+   to hold it, which stage_cache_fill() then populates. stage_cache_restore()
+   verifies a cache entry and loads it, returning the loaded size or 0. */
+size_t stage_cache_prepare(int stage_id, const struct prog *stage,
+			   struct stage_cache *meta);
+void stage_cache_fill(void *c, size_t size, const struct prog *stage,
+		      struct stage_cache *meta);
+size_t stage_cache_restore(const struct stage_cache *meta, const void *c,
+			   size_t size);
+
 #endif /* _STAGE_CACHE_H_ */
@@ -137,6 +137,17 @@ static inline bool cbfs_lzma_enabled(void)
 	return true;
 }
 
+static inline bool cbfs_zstd_enabled(void)
+{
+	/* The decoder context is too large for CAR, so Zstandard is only
+	   supported for payloads and for ramstage loaded from postcar. */
+	if (ENV_RAMSTAGE)
+		return CONFIG(COMPRESSED_PAYLOAD_ZSTD);
+	if (ENV_POSTCAR)
+		return CONFIG(COMPRESS_RAMSTAGE_ZSTD);
+	return false;
+}
+
 size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 	size_t in_size, void *buffer, size_t buffer_size, uint32_t compression)
 {
@@ -185,6 +196,22 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 
 		return out_size;
 
+	case CBFS_COMPRESS_ZSTD:
+		if (!cbfs_zstd_enabled())
+			return 0;
+		map = rdev_mmap(rdev, offset, in_size);
+		if (map == NULL)
+			return 0;
+
+		/* Note: timestamp not useful for memory-mapped media (x86) */
+		timestamp_add_now(TS_START_UZSTD);
+		out_size = uzstdn(map, in_size, buffer, buffer_size);
+		timestamp_add_now(TS_END_UZSTD);
+
+		rdev_munmap(rdev, map);
+
+		return out_size;
+
 	default:
 		return 0;
 	}
@@ -192,13 +219,25 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 
 static size_t cbfs_stage_load_and_decompress(const struct region_device *rdev,
 		size_t offset, size_t in_size, void *buffer, size_t buffer_size,
-		uint32_t compression)
+		uint32_t compression, size_t inplace_size)
 {
 	struct region_device rdev_src;
+	bool inplace;
 
 	if (compression == CBFS_COMPRESS_LZ4) {
 		if (!cbfs_lz4_enabled())
 			return 0;
+		inplace = true;
+	} else {
+		/* Other algorithms would need a scratch copy of the compressed
+		 * data on media that isn't memory mapped, unless cbfstool told
+		 * us that the stage's memory is big enough to do it in place. */
+		inplace = !CONFIG(BOOT_DEVICE_MEMORY_MAPPED) &&
+			compression != CBFS_COMPRESS_NONE &&
+			inplace_size && inplace_size <= buffer_size;
+	}
+
+	if (inplace) {
 		/* Load the compressed image to the end of the available memory
 		 * area for in-place decompression. It is the responsibility of
 		 * the caller to ensure that buffer_size is large enough
@@ -214,7 +253,7 @@ static size_t cbfs_stage_load_and_decompress(const struct region_device *rdev,
 					buffer_size, compression);
 	}
 
-	/* All other algorithms can use the generic implementation. */
+	/* Otherwise the generic implementation maps the compressed data. */
 	return cbfs_load_and_decompress(rdev, offset, in_size, buffer,
 					buffer_size, compression);
 }
@@ -314,7 +353,8 @@ int cbfs_prog_stage_load(struct prog *pstage)
 	}
 
 	fsize = cbfs_stage_load_and_decompress(fh, foffset, fsize, load,
-					 stage.memlen, stage.compression);
+					 stage.memlen, stage.compression,
+					 pstage->cbfs_inplace_size);
 	if (!fsize)
 		return -1;
 
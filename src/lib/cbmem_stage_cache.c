@@ -10,6 +10,7 @@ void stage_cache_add(int stage_id, const struct prog *stage)
 {
 	struct stage_cache *meta;
 	void *c;
+	size_t size;
 
 	meta = cbmem_add(CBMEM_ID_STAGEx_META + stage_id, sizeof(*meta));
 	if (meta == NULL) {
@@ -17,18 +18,16 @@ void stage_cache_add(int stage_id, const struct prog *stage)
 				CBMEM_ID_STAGEx_META + stage_id);
 		return;
 	}
-	meta->load_addr = (uintptr_t)prog_start(stage);
-	meta->entry_addr = (uintptr_t)prog_entry(stage);
-	meta->arg = (uintptr_t)prog_entry_arg(stage);
+	size = stage_cache_prepare(stage_id, stage, meta);
 
-	c = cbmem_add(CBMEM_ID_STAGEx_CACHE + stage_id, prog_size(stage));
+	c = cbmem_add(CBMEM_ID_STAGEx_CACHE + stage_id, size);
 	if (c == NULL) {
 		printk(BIOS_ERR, "Error: Can't add stage_cache %x to cbmem\n",
 				CBMEM_ID_STAGEx_CACHE + stage_id);
 		return;
 	}
 
-	memcpy(c, prog_start(stage), prog_size(stage));
+	stage_cache_fill(c, size, stage, meta);
 }
 
 void stage_cache_add_raw(int stage_id, const void *base, const size_t size)
@@ -86,11 +85,11 @@ void stage_cache_load_stage(int stage_id, struct prog *stage)
 	}
 
 	c = cbmem_entry_start(e);
-	size = cbmem_entry_size(e);
+	size = stage_cache_restore(meta, c, cbmem_entry_size(e));
+	if (!size)
+		return;
 	load_addr = (void *)(uintptr_t)meta->load_addr;
 
-	memcpy(load_addr, c, size);
-
 	prog_set_area(stage, load_addr, size);
 	prog_set_entry(stage, (void *)(uintptr_t)meta->entry_addr,
 			(void *)(uintptr_t)meta->arg);
@@ -43,6 +43,7 @@ void stage_cache_add(int stage_id, const struct prog *stage)
 	const struct imd_entry *e;
 	struct stage_cache *meta;
 	void *c;
+	size_t size;
 
 	imd = &imd_stage_cache;
 	e = imd_entry_add(imd, CBMEM_ID_STAGEx_META + stage_id, sizeof(*meta));
@@ -55,12 +56,9 @@ void stage_cache_add(int stage_id, const struct prog *stage)
 
 	meta = imd_entry_at(imd, e);
 
-	meta->load_addr = (uintptr_t)prog_start(stage);
-	meta->entry_addr = (uintptr_t)prog_entry(stage);
-	meta->arg = (uintptr_t)prog_entry_arg(stage);
+	size = stage_cache_prepare(stage_id, stage, meta);
 
-	e = imd_entry_add(imd, CBMEM_ID_STAGEx_CACHE + stage_id,
-				prog_size(stage));
+	e = imd_entry_add(imd, CBMEM_ID_STAGEx_CACHE + stage_id, size);
 
 	if (e == NULL) {
 		printk(BIOS_DEBUG, "Error: Can't add stage_cache %x to imd\n",
@@ -70,7 +68,7 @@ void stage_cache_add(int stage_id, const struct prog *stage)
 
 	c = imd_entry_at(imd, e);
 
-	memcpy(c, prog_start(stage), prog_size(stage));
+	stage_cache_fill(c, size, stage, meta);
 }
 
 void stage_cache_add_raw(int stage_id, const void *base, const size_t size)
@@ -141,9 +139,9 @@ void stage_cache_load_stage(int stage_id, struct prog *stage)
 	}
 
 	c = imd_entry_at(imd, e);
-	size = imd_entry_size(e);
-
-	memcpy((void *)(uintptr_t)meta->load_addr, c, size);
+	size = stage_cache_restore(meta, c, imd_entry_size(e));
+	if (!size)
+		return;
 
 	prog_set_area(stage, (void *)(uintptr_t)meta->load_addr, size);
 	prog_set_entry(stage, (void *)(uintptr_t)meta->entry_addr,
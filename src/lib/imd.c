@@ -125,6 +125,7 @@ static void imdr_init(struct imdr *ir, void *upper_limit)
 	/* Upper limit is aligned down to 4KiB */
 	ir->limit = ALIGN_DOWN(limit, LIMIT_ALIGN);
 	ir->r = NULL;
+	ir->index_root = NULL;
 }
 
 static int imdr_create_empty(struct imdr *imdr, size_t root_size,
@@ -165,6 +166,7 @@ static int imdr_create_empty(struct imdr *imdr, size_t root_size,
 	root_offset = -(ssize_t)root_size;
 	/* Set root pointer. */
 	imdr->r = relative_pointer((void *)imdr->limit, root_offset);
+	imdr->index_root = NULL;
 	r = imdr_root(imdr);
 	imd_link_root(rp, r);
 
@@ -235,10 +237,67 @@ static int imdr_recover(struct imdr *imdr)
 
 	/* Set root pointer. */
 	imdr->r = r;
+	imdr->index_root = NULL;
 
 	return 0;
 }
 
+/*
+ * Each handle caches an open addressing hash of entry id -> entry index for
+ * its root. Slots hold the entry index, 0 marks an empty slot since entry 0
+ * always covers the root itself. Roots with more than IMD_INDEX_MAX_ENTRIES
+ * entries fall back to a linear scan. index_entries is the number of root
+ * entries already hashed. Entries are only ever appended or removed from the
+ * end, so the index is brought up to date by hashing the new entries or
+ * rebuilt when entries went away. It is never written back to the root, and
+ * only entries added and removed through the same handle are tracked.
+ */
+#define IMD_INDEX_MAX_ENTRIES (IMD_INDEX_SLOTS * 3 / 4)
+
+static size_t imd_index_slot(uint32_t id)
+{
+	return ((id * 0x9e3779b1) >> 16) % IMD_INDEX_SLOTS;
+}
+
+static void imd_index_insert(struct imdr *imdr, const struct imd_root *r,
+				size_t idx)
+{
+	uint32_t id = r->entries[idx].id;
+	size_t slot;
+
+	for (slot = imd_index_slot(id); imdr->index[slot] != 0;
+	     slot = (slot + 1) % IMD_INDEX_SLOTS) {
+		/* Lookups return the first entry with a given id. */
+		if (r->entries[imdr->index[slot]].id == id)
+			return;
+	}
+
+	imdr->index[slot] = idx;
+}
+
+static bool imdr_index_sync(const struct imdr *imdr)
+{
+	/* The index is a cache: keep it current even through const handles. */
+	struct imdr *ir = (struct imdr *)imdr;
+	struct imd_root *r = imdr_root(imdr);
+	size_t i;
+
+	if (!CONFIG(IMD_ENTRY_INDEX) || r->num_entries > IMD_INDEX_MAX_ENTRIES)
+		return false;
+
+	if (ir->index_root != r || r->num_entries < ir->index_entries) {
+		memset(ir->index, 0, sizeof(ir->index));
+		ir->index_root = r;
+		ir->index_entries = 1;
+	}
+
+	for (i = ir->index_entries; i < r->num_entries; i++)
+		imd_index_insert(ir, r, i);
+	ir->index_entries = r->num_entries;
+
+	return true;
+}
+
 static const struct imd_entry *imdr_entry_find(const struct imdr *imdr,
 						uint32_t id)
 {
@@ -251,6 +310,16 @@ static const struct imd_entry *imdr_entry_find(const struct imdr *imdr,
 	if (r == NULL)
 		return NULL;
 
+	if (imdr_index_sync(imdr)) {
+		for (i = imd_index_slot(id); imdr->index[i] != 0;
+		     i = (i + 1) % IMD_INDEX_SLOTS) {
+			e = &r->entries[imdr->index[i]];
+			if (e->id == id)
+				return e;
+		}
+		return NULL;
+	}
+
 	e = NULL;
 	/* Skip first entry covering the root. */
 	for (i = 1; i < r->num_entries; i++) {
@@ -636,6 +705,9 @@ int imd_entry_remove(const struct imd *imd, const struct imd_entry *entry)
 
 	r->num_entries--;
 
+	/* Drop the index, the next entry added may reuse the slot. */
+	((struct imdr *)imdr)->index_root = NULL;
+
 	return 0;
 }
 
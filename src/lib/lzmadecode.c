@@ -29,15 +29,20 @@
 #define kBitModelTotal (1 << kNumBitModelTotalBits)
 #define kNumMoveBits 5
 
-/* Use 32-bit reads whenever possible to avoid bad flash performance. Fall back
- * to byte reads for last 4 bytes since RC_TEST returns an error when BufferLim
- * is *reached* (not surpassed!), meaning we can't allow that to happen while
- * there are still bytes to decode from the algorithm's point of view. */
+/* Use native word sized reads whenever possible to avoid bad flash
+ * performance. Fall back to byte reads for the last word since RC_TEST returns
+ * an error when BufferLim is *reached* (not surpassed!), meaning we can't allow
+ * that to happen while there are still bytes to decode from the algorithm's
+ * point of view. */
+#define LOOK_AHEAD_SIZE ((int)sizeof(uintptr_t))
 #define RC_READ_BYTE							\
-	(look_ahead_ptr < 4 ? look_ahead.raw[look_ahead_ptr++]		\
-	: ((((uintptr_t) Buffer & 3)					\
-		|| ((SizeT) (BufferLim - Buffer) <= 4)) ? (*Buffer++)	\
-	: ((look_ahead.dw = *(UInt32 *)Buffer), (Buffer += 4),		\
+	(look_ahead_ptr < LOOK_AHEAD_SIZE				\
+		? look_ahead.raw[look_ahead_ptr++]			\
+	: ((((uintptr_t) Buffer & (LOOK_AHEAD_SIZE - 1))		\
+		|| ((SizeT) (BufferLim - Buffer) <= LOOK_AHEAD_SIZE))	\
+		? (*Buffer++)						\
+	: ((look_ahead.word = *(uintptr_t *)Buffer),			\
+		(Buffer += LOOK_AHEAD_SIZE),				\
 		(look_ahead_ptr = 1), look_ahead.raw[0])))
 
 #define RC_INIT2 Code = 0; Range = 0xFFFFFFFF;		\
@@ -91,6 +96,29 @@
 
 #define RC_GET_BIT(p, mi) RC_GET_BIT2(p, mi, ;, ;)
 
+/*
+ * Branchless variant of RC_GET_BIT() for bit trees, where the decoded bits
+ * are essentially random and a mispredicted branch costs more than computing
+ * both outcomes. mask is all ones for a 1 bit and zero for a 0 bit. The
+ * probability update relies on an arithmetic right shift: subtracting
+ * (p - (kBitModelTotal - 31)) >> 5 is the same as adding
+ * (kBitModelTotal - p) >> 5, and subtracting (p - 0) >> 5 is UpdateBit1().
+ */
+#define RC_GET_BIT_BRANCHLESS(p, mi)					\
+{									\
+	UInt32 mask;							\
+									\
+	RC_NORMALIZE;							\
+	bound = (Range >> kNumBitModelTotalBits) * *(p);		\
+	mask = 0 - (UInt32)(Code >= bound);				\
+	Range = (bound & ~mask) | ((Range - bound) & mask);		\
+	Code -= bound & mask;						\
+	*(p) -= ((int)*(p) - (int)((kBitModelTotal -			\
+		((1 << kNumMoveBits) - 1)) & ~mask))			\
+		>> kNumMoveBits;					\
+	mi = (mi + mi) - mask;						\
+}
+
 #define RangeDecoderBitTreeDecode(probs, numLevels, res)	\
 {								\
 	int i = numLevels;					\
@@ -98,7 +126,7 @@
 	res = 1;						\
 	do {							\
 		CProb *cp = probs + res;			\
-		RC_GET_BIT(cp, res)				\
+		RC_GET_BIT_BRANCHLESS(cp, res)			\
 	} while (--i != 0);					\
 	res -= (1 << numLevels);				\
 }
@@ -200,10 +228,10 @@ int LzmaDecode(CLzmaDecoderState *vs,
 	int len = 0;
 	const Byte *Buffer;
 	const Byte *BufferLim;
-	int look_ahead_ptr = 4;
+	int look_ahead_ptr = LOOK_AHEAD_SIZE;
 	union {
-		Byte raw[4];
-		UInt32 dw;
+		Byte raw[LOOK_AHEAD_SIZE];
+		uintptr_t word;
 	} look_ahead;
 	UInt32 Range;
 	UInt32 Code;
@@ -253,7 +281,7 @@ int LzmaDecode(CLzmaDecoderState *vs,
 			}
 			while (symbol < 0x100) {
 				CProb *probLit = prob + symbol;
-				RC_GET_BIT(probLit, symbol)
+				RC_GET_BIT_BRANCHLESS(probLit, symbol)
 			}
 			previousByte = (Byte)symbol;
 
@@ -414,11 +442,22 @@ int LzmaDecode(CLzmaDecoderState *vs,
 				return LZMA_RESULT_DATA_ERROR;
 
 
-			do {
-				previousByte = outStream[nowPos - rep0];
-				len--;
-				outStream[nowPos++] = previousByte;
-			} while (len != 0 && nowPos < outSize);
+			{
+				/* Matches may overlap their own output, so this
+				   has to stay a forward byte-by-byte copy. */
+				SizeT copy = outSize - nowPos;
+				const Byte *src = outStream + nowPos - rep0;
+				Byte *dst = outStream + nowPos;
+
+				if (copy > (SizeT)len)
+					copy = len;
+				nowPos += copy;
+				len -= copy;
+				do {
+					*dst++ = *src++;
+				} while (--copy != 0);
+				previousByte = dst[-1];
+			}
 		}
 	}
 	RC_NORMALIZE;
@@ -2,93 +2,180 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <commonlib/helpers.h>
 #include <console/console.h>
 #include <memrange.h>
 
-static inline void range_entry_link(struct range_entry **prev_ptr,
-				    struct range_entry *r)
+/*
+ * The entries of a memranges are kept in a single array sorted by address.
+ * Entries never overlap and neighbors with the same tag are always merged,
+ * so the end addresses are sorted as well and lookups can bisect the array.
+ *
+ * Arrays are allocated from a pool. coreboot doesn't have a working free()
+ * so arrays that are outgrown or released by memranges_teardown() are put
+ * back in the pool for the next memranges to use.
+ */
+#define RANGE_POOL_MIN_ENTRIES 8
+
+struct range_pool_block {
+	struct range_pool_block *next;
+	size_t num_entries;
+};
+
+_Static_assert(sizeof(struct range_pool_block) <=
+	       RANGE_POOL_MIN_ENTRIES * sizeof(struct range_entry),
+	       "Pool block header doesn't fit in the smallest array");
+
+static struct range_pool_block *range_pool;
+
+static struct range_entry *range_pool_alloc(size_t *num_entries)
 {
-	r->next = *prev_ptr;
-	*prev_ptr = r;
+	struct range_pool_block **prev_ptr;
+	struct range_pool_block *b;
+
+	for (prev_ptr = &range_pool; *prev_ptr != NULL; prev_ptr = &b->next) {
+		b = *prev_ptr;
+		if (b->num_entries < *num_entries)
+			continue;
+		*prev_ptr = b->next;
+		*num_entries = b->num_entries;
+		return (struct range_entry *)b;
+	}
+
+	return malloc(*num_entries * sizeof(struct range_entry));
 }
 
-static inline void range_entry_unlink(struct range_entry **prev_ptr,
-				      struct range_entry *r)
+static void range_pool_free(struct range_entry *entries, size_t num_entries)
 {
-	*prev_ptr = r->next;
-	r->next = NULL;
+	struct range_pool_block *b = (struct range_pool_block *)entries;
+
+	b->num_entries = num_entries;
+	b->next = range_pool;
+	range_pool = b;
 }
 
-static inline void range_entry_unlink_and_free(struct memranges *ranges,
-					       struct range_entry **prev_ptr,
-					       struct range_entry *r)
+static void release_entries(struct memranges *ranges)
 {
-	range_entry_unlink(prev_ptr, r);
-	range_entry_link(&ranges->free_list, r);
+	if (ranges->pooled)
+		range_pool_free(ranges->entries, ranges->max_entries);
+
+	ranges->entries = NULL;
+	ranges->num_entries = 0;
+	ranges->max_entries = 0;
+	ranges->pooled = false;
+}
+
+/* Make room for at least num_entries entries. */
+static bool reserve_entries(struct memranges *ranges, size_t num_entries)
+{
+	struct range_entry *entries;
+	size_t max_entries;
+
+	if (num_entries <= ranges->max_entries)
+		return true;
+
+	if (!ENV_PAYLOAD_LOADER)
+		return false;
+
+	max_entries = MAX(ranges->max_entries * 2, num_entries);
+	max_entries = MAX(max_entries, RANGE_POOL_MIN_ENTRIES);
+	entries = range_pool_alloc(&max_entries);
+	if (entries == NULL)
+		return false;
+
+	if (ranges->num_entries)
+		memcpy(entries, ranges->entries,
+		       ranges->num_entries * sizeof(*entries));
+	if (ranges->pooled)
+		range_pool_free(ranges->entries, ranges->max_entries);
+
+	ranges->entries = entries;
+	ranges->max_entries = max_entries;
+	ranges->pooled = true;
+
+	return true;
 }
 
-static struct range_entry *alloc_range(struct memranges *ranges)
+/* Return index of the first entry ending at or after addr. */
+static size_t find_entry_index(const struct memranges *ranges, resource_t addr)
 {
-	if (ranges->free_list != NULL) {
-		struct range_entry *r;
+	size_t lo = 0;
+	size_t hi = ranges->num_entries;
 
-		r = ranges->free_list;
-		range_entry_unlink(&ranges->free_list, r);
-		return r;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (ranges->entries[mid].end < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-	if (ENV_PAYLOAD_LOADER)
-		return malloc(sizeof(struct range_entry));
-	return NULL;
+
+	return lo;
 }
 
-static inline struct range_entry *
-range_list_add(struct memranges *ranges, struct range_entry **prev_ptr,
+static struct range_entry *
+range_list_add(struct memranges *ranges, size_t idx,
 	       resource_t begin, resource_t end, unsigned long tag)
 {
 	struct range_entry *new_entry;
 
-	new_entry = alloc_range(ranges);
-	if (new_entry == NULL) {
+	if (!reserve_entries(ranges, ranges->num_entries + 1)) {
 		printk(BIOS_ERR, "Could not allocate range_entry!\n");
 		return NULL;
 	}
+
+	new_entry = &ranges->entries[idx];
+	memmove(new_entry + 1, new_entry,
+		(ranges->num_entries - idx) * sizeof(*new_entry));
+	ranges->num_entries++;
+
 	new_entry->begin = begin;
 	new_entry->end = end;
 	new_entry->tag = tag;
-	range_entry_link(prev_ptr, new_entry);
 
 	return new_entry;
 }
 
+static void range_list_delete(struct memranges *ranges, size_t idx,
+			      size_t count)
+{
+	struct range_entry *r = &ranges->entries[idx];
+
+	if (count == 0)
+		return;
+
+	memmove(r, r + count,
+		(ranges->num_entries - idx - count) * sizeof(*r));
+	ranges->num_entries -= count;
+}
+
 static void merge_neighbor_entries(struct memranges *ranges)
 {
-	struct range_entry *cur;
-	struct range_entry *prev;
+	size_t prev;
+	size_t cur;
 
-	prev = NULL;
-	/* Merge all neighbors and delete/free the leftover entry. */
-	for (cur = ranges->entries; cur != NULL; cur = cur->next) {
-		/* First entry. Just set prev. */
-		if (prev == NULL) {
-			prev = cur;
-			continue;
-		}
+	if (ranges->num_entries == 0)
+		return;
+
+	/* Merge all neighbors, compacting the array as we go. */
+	prev = 0;
+	for (cur = 1; cur < ranges->num_entries; cur++) {
+		struct range_entry *p = &ranges->entries[prev];
+		const struct range_entry *c = &ranges->entries[cur];
 
 		/* If the previous entry merges with the current update the
-		 * previous entry to cover full range and delete current from
-		 * the list. */
-		if (prev->end + 1 >= cur->begin && prev->tag == cur->tag) {
-			prev->end = cur->end;
-			range_entry_unlink_and_free(ranges, &prev->next, cur);
-			/* Set cur to prev so cur->next is valid since cur
-			 * was just unlinked and free. */
-			cur = prev;
+		 * previous entry to cover the full range. */
+		if (p->end + 1 >= c->begin && p->tag == c->tag) {
+			p->end = c->end;
 			continue;
 		}
 
-		prev = cur;
+		ranges->entries[++prev] = *c;
 	}
+
+	ranges->num_entries = prev + 1;
 }
 
 static void remove_memranges(struct memranges *ranges,
@@ -96,99 +183,80 @@ static void remove_memranges(struct memranges *ranges,
 			     unsigned long unused)
 {
 	struct range_entry *cur;
-	struct range_entry *next;
-	struct range_entry **prev_ptr;
-
-	prev_ptr = &ranges->entries;
-	for (cur = ranges->entries; cur != NULL; cur = next) {
-		resource_t tmp_end;
+	size_t first;
+	size_t last;
 
-		/* Cache the next value to handle unlinks. */
-		next = cur->next;
-
-		/* No other ranges are affected. */
-		if (end < cur->begin)
-			break;
-
-		/* The removal range starts after this one. */
-		if (begin > cur->end) {
-			prev_ptr = &cur->next;
-			continue;
-		}
-
-		/* The removal range overlaps with the current entry either
-		 * partially or fully. However, we need to adjust the removal
-		 * range for any holes. */
-		if (begin <= cur->begin) {
-			begin = cur->begin;
-
-			/* Full removal. */
-			if (end >= cur->end) {
-				begin = cur->end + 1;
-				range_entry_unlink_and_free(ranges, prev_ptr,
-							    cur);
-				continue;
-			}
-		}
+	first = find_entry_index(ranges, begin);
+	if (first == ranges->num_entries)
+		return;
 
-		/* prev_ptr can be set now that the unlink path wasn't taken. */
-		prev_ptr = &cur->next;
+	cur = &ranges->entries[first];
 
-		/* Clip the end fragment to do proper splitting. */
-		tmp_end = end;
-		if (end > cur->end)
-			tmp_end = cur->end;
+	/* No other ranges are affected. */
+	if (end < cur->begin)
+		return;
 
+	if (begin > cur->begin) {
 		/* Hole punched in middle of entry. */
-		if (begin > cur->begin && tmp_end < cur->end) {
-			range_list_add(ranges, &cur->next, end + 1, cur->end,
-				       cur->tag);
+		if (end < cur->end) {
+			resource_t cur_end = cur->end;
+
 			cur->end = begin - 1;
-			break;
+			range_list_add(ranges, first + 1, end + 1, cur_end,
+				       cur->tag);
+			return;
 		}
 
-		/* Removal at beginning. */
-		if (begin == cur->begin)
-			cur->begin = tmp_end + 1;
-
 		/* Removal at end. */
-		if (tmp_end == cur->end)
-			cur->end = begin - 1;
+		cur->end = begin - 1;
+		first++;
 	}
+
+	/* Full removal of all entries ending within the range. */
+	last = find_entry_index(ranges, end);
+	if (last < ranges->num_entries && ranges->entries[last].end == end)
+		last++;
+
+	/* Removal at beginning. */
+	if (last < ranges->num_entries && ranges->entries[last].begin <= end)
+		ranges->entries[last].begin = end + 1;
+
+	range_list_delete(ranges, first, last - first);
 }
 
 static void merge_add_memranges(struct memranges *ranges,
 				resource_t begin, resource_t end,
 				unsigned long tag)
 {
-	struct range_entry *cur;
-	struct range_entry **prev_ptr;
-
-	prev_ptr = &ranges->entries;
+	struct range_entry *prev = NULL;
+	struct range_entry *next = NULL;
+	size_t idx;
 
 	/* Remove all existing entries covered by the range. */
 	remove_memranges(ranges, begin, end, -1);
 
-	/* Find the entry to place the new entry after. Since
-	 * remove_memranges() was called above there is a guaranteed
-	 * spot for this new entry. */
-	for (cur = ranges->entries; cur != NULL; cur = cur->next) {
-		/* Found insertion spot before current entry. */
-		if (end < cur->begin)
-			break;
-
-		/* Keep track of previous entry to insert new entry after it. */
-		prev_ptr = &cur->next;
-
-		/* The new entry starts after this one. */
-		if (begin > cur->end)
-			continue;
-
+	/* Since remove_memranges() was called above the new entry goes
+	 * right before the first entry ending after it. */
+	idx = find_entry_index(ranges, end);
+
+	if (idx > 0 && ranges->entries[idx - 1].end + 1 == begin &&
+	    ranges->entries[idx - 1].tag == tag)
+		prev = &ranges->entries[idx - 1];
+	if (idx < ranges->num_entries && end + 1 == ranges->entries[idx].begin &&
+	    ranges->entries[idx].tag == tag)
+		next = &ranges->entries[idx];
+
+	/* Add new entry or merge it with its neighbors. */
+	if (prev != NULL && next != NULL) {
+		prev->end = next->end;
+		range_list_delete(ranges, idx, 1);
+	} else if (prev != NULL) {
+		prev->end = end;
+	} else if (next != NULL) {
+		next->begin = begin;
+	} else {
+		range_list_add(ranges, idx, begin, end, tag);
 	}
-
-	/* Add new entry and merge with neighbors. */
-	range_list_add(ranges, prev_ptr, begin, end, tag);
-	merge_neighbor_entries(ranges);
 }
 
 void memranges_update_tag(struct memranges *ranges, unsigned long old_tag,
@@ -284,14 +352,11 @@ void memranges_init_empty_with_alignment(struct memranges *ranges,
 					 struct range_entry *to_free,
 					 size_t num_free, unsigned char align)
 {
-	size_t i;
-
-	ranges->entries = NULL;
-	ranges->free_list = NULL;
+	ranges->entries = to_free;
+	ranges->num_entries = 0;
+	ranges->max_entries = to_free != NULL ? num_free : 0;
+	ranges->pooled = false;
 	ranges->align = align;
-
-	for (i = 0; i < num_free; i++)
-		range_entry_link(&ranges->free_list, &to_free[i]);
 }
 
 void memranges_init_with_alignment(struct memranges *ranges,
@@ -305,66 +370,69 @@ void memranges_init_with_alignment(struct memranges *ranges,
 /* Clone a memrange. The new memrange has the same entries as the old one. */
 void memranges_clone(struct memranges *newranges, struct memranges *oldranges)
 {
-	struct range_entry *r, *cur;
-	struct range_entry **prev_ptr;
-
 	memranges_init_empty_with_alignment(newranges, NULL, 0, oldranges->align);
 
-	prev_ptr = &newranges->entries;
-	memranges_each_entry(r, oldranges) {
-		cur = range_list_add(newranges, prev_ptr, r->begin, r->end,
-				     r->tag);
-		prev_ptr = &cur->next;
+	if (!reserve_entries(newranges, oldranges->num_entries)) {
+		printk(BIOS_ERR, "Could not allocate range_entry!\n");
+		return;
 	}
+
+	if (oldranges->num_entries)
+		memcpy(newranges->entries, oldranges->entries,
+		       oldranges->num_entries * sizeof(*oldranges->entries));
+	newranges->num_entries = oldranges->num_entries;
 }
 
 void memranges_teardown(struct memranges *ranges)
 {
-	while (ranges->entries != NULL) {
-		range_entry_unlink_and_free(ranges, &ranges->entries,
-					    ranges->entries);
+	/* Keep caller provided storage around for reuse. */
+	if (!ranges->pooled) {
+		ranges->num_entries = 0;
+		return;
 	}
+
+	release_entries(ranges);
 }
 
 void memranges_fill_holes_up_to(struct memranges *ranges,
 				resource_t limit, unsigned long tag)
 {
-	struct range_entry *cur;
 	struct range_entry *prev;
+	size_t i;
 
-	prev = NULL;
-	for (cur = ranges->entries; cur != NULL; cur = cur->next) {
-		/* First entry. Just set prev. */
-		if (prev == NULL) {
-			prev = cur;
-			continue;
-		}
+	if (ranges->num_entries == 0 || limit == 0)
+		return;
+
+	for (i = 1; i < ranges->num_entries; i++) {
+		resource_t begin;
+		resource_t end;
+
+		prev = &ranges->entries[i - 1];
+		begin = range_entry_end(prev);
 
 		/* If the previous entry does not directly precede the current
 		 * entry then add a new entry just after the previous one. */
-		if (range_entry_end(prev) != cur->begin) {
-			resource_t end;
-
-			end = cur->begin - 1;
+		if (begin != ranges->entries[i].begin && begin < limit) {
+			end = ranges->entries[i].begin - 1;
 			if (end >= limit)
 				end = limit - 1;
-			range_list_add(ranges, &prev->next,
-				       range_entry_end(prev), end, tag);
+			if (range_list_add(ranges, i, begin, end, tag) == NULL)
+				break;
+			i++;
 		}
 
-		prev = cur;
-
 		/* Hit the requested range limit. No other entries after this
 		 * are affected. */
-		if (cur->begin >= limit)
+		if (ranges->entries[i].begin >= limit)
 			break;
 	}
 
 	/* Handle the case where the limit was never reached. A new entry needs
 	 * to be added to cover the range up to the limit. */
-	if (prev != NULL && range_entry_end(prev) < limit)
-		range_list_add(ranges, &prev->next, range_entry_end(prev),
-			       limit - 1, tag);
+	prev = &ranges->entries[ranges->num_entries - 1];
+	if (i == ranges->num_entries && prev->end < limit - 1)
+		range_list_add(ranges, ranges->num_entries,
+			       range_entry_end(prev), limit - 1, tag);
 
 	/* Merge all entries that were newly added. */
 	merge_neighbor_entries(ranges);
@@ -373,16 +441,23 @@ void memranges_fill_holes_up_to(struct memranges *ranges,
 struct range_entry *memranges_next_entry(struct memranges *ranges,
 					 const struct range_entry *r)
 {
-	return r->next;
+	size_t idx = r - ranges->entries;
+
+	if (idx + 1 >= ranges->num_entries)
+		return NULL;
+
+	return &ranges->entries[idx + 1];
 }
 
 /* Find a range entry that satisfies the given constraints to fit a hole that matches the
  * required alignment, is big enough, does not exceed the limit and has a matching tag. */
 static const struct range_entry *memranges_find_entry(struct memranges *ranges,
 						      resource_t limit, resource_t size,
-						      unsigned char align, unsigned long tag)
+						      unsigned char align, unsigned long tag,
+						      enum memranges_fit fit)
 {
 	const struct range_entry *r;
+	const struct range_entry *best = NULL;
 	resource_t base, end;
 
 	if (size == 0)
@@ -407,17 +482,23 @@ static const struct range_entry *memranges_find_entry(struct memranges *ranges,
 		if (end > limit)
 			break;
 
-		return r;
+		if (fit == MEMRANGES_FIRST_FIT)
+			return r;
+
+		if (best == NULL || range_entry_size(r) < range_entry_size(best))
+			best = r;
 	}
 
-	return NULL;
+	return best;
 }
 
 bool memranges_steal(struct memranges *ranges, resource_t limit, resource_t size,
-			unsigned char align, unsigned long tag, resource_t *stolen_base)
+			unsigned char align, unsigned long tag, enum memranges_fit fit,
+			resource_t *stolen_base)
 {
 	resource_t base;
-	const struct range_entry *r = memranges_find_entry(ranges, limit, size, align, tag);
+	const struct range_entry *r = memranges_find_entry(ranges, limit, size, align, tag,
+							   fit);
 
 	if (r == NULL)
 		return false;
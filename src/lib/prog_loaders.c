@@ -34,6 +34,12 @@ int prog_locate(struct prog *prog)
 
 	cbfsf_file_type(&file, &prog->cbfs_type);
 
+	size_t decompressed_size, margin;
+	if (cbfsf_inplace_info(&file, &decompressed_size, &margin))
+		prog->cbfs_inplace_size = 0;
+	else
+		prog->cbfs_inplace_size = decompressed_size + margin;
+
 	cbfs_file_data(prog_rdev(prog), &file);
 
 	return 0;
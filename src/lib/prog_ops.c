@@ -1,6 +1,8 @@
 /* SPDX-License-Identifier: GPL-2.0-only */
 
+#include <console/console.h>
 #include <program_loading.h>
+#include <security/tpm/tspi/crtm.h>
 
 /* For each segment of a program loaded this function is called*/
 void prog_segment_loaded(uintptr_t start, size_t size, int flags)
@@ -23,6 +25,10 @@ void __weak arch_segment_loaded(uintptr_t start, size_t size,
 
 void prog_run(struct prog *prog)
 {
+	/* Deferred measurements must reach the TPM before measured code runs. */
+	if (tspi_measure_flush_hook())
+		die("TPM: Failed to extend deferred measurements\n");
+
 	platform_prog_run(prog);
 	arch_prog_run(prog);
 }
@@ -27,6 +27,12 @@
  * write and the data write results in blocks being allocated but not
  * entirely written. It's up to the user of the library to sanity check
  * data stored.
+ *
+ * Finding the latest update takes a binary search over the metadata blocks
+ * followed by a scan of the 8 block offsets within the last used one. Since
+ * updates are appended until the region is full, every part of the region is
+ * erased once per fill cycle. When the region has filled up only the part
+ * that has actually been written is erased, in REGF_ERASE_GRANULARITY units.
  */
 
 #define REGF_BLOCK_SHIFT		4
@@ -35,6 +41,8 @@
 #define REGF_UNALLOCATED_BLOCK		0xffff
 #define REGF_UPDATES_PER_METADATA_BLOCK	\
 	(REGF_METADATA_BLOCK_SIZE / sizeof(uint16_t))
+/* Smallest erase size commonly supported by SPI flash parts. */
+#define REGF_ERASE_GRANULARITY		(4 * KiB)
 
 enum {
 	RF_ONLY_METADATA = 0,
@@ -399,12 +407,34 @@ static int handle_need_to_empty(struct region_file *f)
 	return 0;
 }
 
+/*
+ * Erase the written part of a full region so that it can be reused. The data
+ * past the last update was never written so there is no need to erase it.
+ * Fall back to emptying the whole region if the partial erase fails, e.g.
+ * because the flash part doesn't support erasing at that granularity.
+ */
+static void handle_full(struct region_file *f)
+{
+	size_t used = MAX(region_device_sz(&f->metadata),
+			  block_to_bytes(region_file_data_end(f)));
+
+	used = ALIGN_UP(used, REGF_ERASE_GRANULARITY);
+
+	if (used >= region_device_sz(&f->rdev) ||
+	    rdev_eraseat(&f->rdev, 0, used) < 0) {
+		f->slot = RF_NEED_TO_EMPTY;
+		return;
+	}
+
+	f->slot = RF_EMPTY;
+}
+
 static int handle_update(struct region_file *f, size_t blocks, const void *buf,
 				size_t size)
 {
 	if (!update_can_fit(f, blocks)) {
 		printk(BIOS_INFO, "REGF update can't fit. Will empty.\n");
-		f->slot = RF_NEED_TO_EMPTY;
+		handle_full(f);
 		return 0;
 	}
 
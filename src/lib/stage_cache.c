@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/bsd/compression.h>
+#include <commonlib/bsd/cbfs_serialized.h>
+#include <console/console.h>
+#include <ip_checksum.h>
+#include <rules.h>
+#include <stage_cache.h>
+#include <string.h>
+
+static bool stage_cache_compress(int stage_id)
+{
+	/* The compressor needs 16KiB of .bss, so don't use it from CAR. Only
+	   ramstage is large enough to be worth it. */
+	return CONFIG(COMPRESS_STAGE_CACHE) && !ENV_CACHE_AS_RAM &&
+		stage_id == STAGE_RAMSTAGE;
+}
+
+size_t stage_cache_prepare(int stage_id, const struct prog *stage,
+			   struct stage_cache *meta)
+{
+	size_t size;
+
+	meta->load_addr = (uintptr_t)prog_start(stage);
+	meta->entry_addr = (uintptr_t)prog_entry(stage);
+	meta->arg = (uintptr_t)prog_entry_arg(stage);
+	meta->compression = CBFS_COMPRESS_NONE;
+	meta->size = prog_size(stage);
+	meta->checksum = 0;
+
+	if (!stage_cache_compress(stage_id))
+		return prog_size(stage);
+
+	/* Cache entries can't be shrunk after they are added, so do a dry run
+	   first to get the exact size of the compressed image. */
+	size = clz4fn(prog_start(stage), prog_size(stage), NULL, 0);
+	if (!size || size >= prog_size(stage))
+		return prog_size(stage);
+
+	meta->compression = CBFS_COMPRESS_LZ4;
+	return size;
+}
+
+void stage_cache_fill(void *c, size_t size, const struct prog *stage,
+		      struct stage_cache *meta)
+{
+	if (meta->compression == CBFS_COMPRESS_LZ4) {
+		if (clz4fn(prog_start(stage), prog_size(stage), c, size) != size) {
+			printk(BIOS_ERR, "Error: Can't compress stage_cache\n");
+			meta->compression = STAGE_CACHE_INVALID;
+			return;
+		}
+	} else {
+		memcpy(c, prog_start(stage), size);
+	}
+
+	meta->checksum = compute_ip_checksum(c, size);
+}
+
+size_t stage_cache_restore(const struct stage_cache *meta, const void *c,
+			   size_t size)
+{
+	void *load_addr = (void *)(uintptr_t)meta->load_addr;
+
+	if (compute_ip_checksum(c, size) != meta->checksum) {
+		printk(BIOS_ERR, "Error: stage_cache checksum mismatch\n");
+		return 0;
+	}
+
+	switch (meta->compression) {
+	case CBFS_COMPRESS_NONE:
+		if (size != meta->size)
+			return 0;
+		memcpy(load_addr, c, size);
+		return size;
+	case CBFS_COMPRESS_LZ4:
+		if (!CONFIG(COMPRESS_STAGE_CACHE))
+			return 0;
+		if (ulz4fn(c, size, load_addr, meta->size) != meta->size) {
+			printk(BIOS_ERR, "Error: Can't decompress stage_cache\n");
+			return 0;
+		}
+		return meta->size;
+	default:
+		return 0;
+	}
+}
@@ -55,6 +55,13 @@ uint32_t tpm_extend_pcr(int pcr, enum vb2_hash_algorithm digest_algo,
 			uint8_t *digest, size_t digest_len,
 			const char *name);
 
+/**
+ * Extend all digests that tpm_extend_pcr() only logged so far into their
+ * PCRs, in log order. Must run before control passes to any measured code.
+ * @return TPM_SUCCESS on success. If not a tpm error is returned
+ */
+uint32_t tpm_flush_deferred_extends(void);
+
 /**
  * Issue a TPM_Clear and reenable/reactivate the TPM.
  * @return TPM_SUCCESS on success. If not a tpm error is returned
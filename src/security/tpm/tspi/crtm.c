@@ -102,10 +102,26 @@ static bool is_runtime_data(const char *name)
 	return !strcmp(allowlist, name);
 }
 
+static bool is_data_file(uint32_t cbfs_type)
+{
+	switch (cbfs_type) {
+	case CBFS_TYPE_BOOTSPLASH:
+	case CBFS_TYPE_STRUCT:
+	case CBFS_COMPONENT_CMOS_DEFAULT:
+	case CBFS_TYPE_SPD:
+	case CBFS_TYPE_MRC_CACHE:
+	case CBFS_COMPONENT_CMOS_LAYOUT:
+		return true;
+	default:
+		return false;
+	}
+}
+
 uint32_t tspi_measure_cbfs_hook(struct cbfsf *fh, const char *name)
 {
 	uint32_t pcr_index;
 	uint32_t cbfs_type;
+	uint32_t result;
 	struct region_device rdev;
 	char tcpa_metadata[TCPA_PCR_HASH_NAME];
 
@@ -146,7 +162,19 @@ uint32_t tspi_measure_cbfs_hook(struct cbfsf *fh, const char *name)
 	if (create_tcpa_metadata(&rdev, name, tcpa_metadata) < 0)
 		return VB2_ERROR_UNKNOWN;
 
-	return tpm_measure_region(&rdev, pcr_index, tcpa_metadata);
+	result = tpm_measure_region(&rdev, pcr_index, tcpa_metadata);
+	if (result)
+		return result;
+
+	/*
+	 * Not everything located here is started through prog_run(), e.g. FSP,
+	 * MRC blobs or option ROMs are called directly. Only files that hold
+	 * pure data may stay in the deferred batch.
+	 */
+	if (!is_data_file(cbfs_type))
+		return tspi_measure_flush_hook();
+
+	return VB2_SUCCESS;
 }
 
 int tspi_measure_cache_to_pcr(void)
@@ -50,4 +50,15 @@ uint32_t tspi_measure_cbfs_hook(struct cbfsf *fh, const char *name);
 #define tspi_measure_cbfs_hook(fh, name) 0
 #endif
 
+#if !ENV_SMM && !ENV_DECOMPRESSOR && CONFIG(TPM_MEASURED_BOOT_DEFER_EXTEND)
+/*
+ * Extends the measurements deferred in this stage before the
+ * next program is run.
+ * return 0 if successful, else an error
+ */
+#define tspi_measure_flush_hook() tpm_flush_deferred_extends()
+#else
+#define tspi_measure_flush_hook() 0
+#endif
+
 #endif /* __SECURITY_TSPI_CRTM_H__ */
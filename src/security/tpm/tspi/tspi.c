@@ -6,6 +6,7 @@
 #include <security/tpm/tspi.h>
 #include <security/tpm/tss.h>
 #include <assert.h>
+#include <bootstate.h>
 #include <security/vboot/misc.h>
 #include <vb2_api.h>
 #include <vb2_sha.h>
@@ -215,6 +216,65 @@ uint32_t tpm_clear_and_reenable(void)
 	return TPM_SUCCESS;
 }
 
+/*
+ * Number of entries at the tail of the TCPA log that were recorded by this
+ * stage but not extended into their PCRs yet.
+ */
+static int tpm_extends_pending;
+
+static int tpm_can_defer_extend(size_t digest_len, const char *name)
+{
+	struct tcpa_table *tclt;
+
+	if (!CONFIG(TPM_MEASURED_BOOT_DEFER_EXTEND))
+		return 0;
+
+	/* Only defer what is guaranteed to end up in the log. */
+	if (!name || digest_len > TCPA_DIGEST_MAX_LENGTH)
+		return 0;
+
+	tclt = tcpa_log_init();
+	return tclt && tclt->num_entries < tclt->max_entries;
+}
+
+uint32_t tpm_flush_deferred_extends(void)
+{
+	struct tcpa_table *tclt;
+	uint32_t result;
+
+	if (!CONFIG(TPM_MEASURED_BOOT_DEFER_EXTEND) || !tpm_extends_pending)
+		return TPM_SUCCESS;
+
+	tclt = tcpa_log_init();
+	if (!tclt || tclt->num_entries < tpm_extends_pending) {
+		printk(BIOS_ERR, "TPM: Deferred measurements missing from TCPA log\n");
+		return TPM_E_IOERROR;
+	}
+
+	result = tlcl_lib_init();
+	if (result != TPM_SUCCESS) {
+		printk(BIOS_ERR, "TPM: Can't initialize library.\n");
+		return result;
+	}
+
+	printk(BIOS_DEBUG, "TPM: Extending %d deferred digests\n", tpm_extends_pending);
+
+	/* Extend in log order; drop each entry from the count once it is in. */
+	while (tpm_extends_pending) {
+		struct tcpa_entry *tce =
+			&tclt->entries[tclt->num_entries - tpm_extends_pending];
+
+		printk(BIOS_DEBUG, "TPM: Extending digest for %s into PCR %d\n",
+		       tce->name, tce->pcr);
+		result = tlcl_extend(tce->pcr, tce->digest, NULL);
+		if (result != TPM_SUCCESS)
+			return result;
+		tpm_extends_pending--;
+	}
+
+	return TPM_SUCCESS;
+}
+
 uint32_t tpm_extend_pcr(int pcr, enum vb2_hash_algorithm digest_algo,
 			uint8_t *digest, size_t digest_len, const char *name)
 {
@@ -223,7 +283,19 @@ uint32_t tpm_extend_pcr(int pcr, enum vb2_hash_algorithm digest_algo,
 	if (!digest)
 		return TPM_E_IOERROR;
 
+	if (tspi_tpm_is_setup() && tpm_can_defer_extend(digest_len, name)) {
+		tcpa_log_add_table_entry(name, pcr, digest_algo,
+			digest, digest_len);
+		tpm_extends_pending++;
+		return TPM_SUCCESS;
+	}
+
 	if (tspi_tpm_is_setup()) {
+		/* Keep the PCRs extended in the same order as the log. */
+		result = tpm_flush_deferred_extends();
+		if (result != TPM_SUCCESS)
+			return result;
+
 		result = tlcl_lib_init();
 		if (result != TPM_SUCCESS) {
 			printk(BIOS_ERR, "TPM: Can't initialize library.\n");
@@ -243,6 +315,16 @@ uint32_t tpm_extend_pcr(int pcr, enum vb2_hash_algorithm digest_algo,
 	return TPM_SUCCESS;
 }
 
+#if ENV_RAMSTAGE && CONFIG(TPM_MEASURED_BOOT_DEFER_EXTEND)
+/* The S3 resume path jumps to the OS without going through prog_run(). */
+static void tpm_flush_on_resume(void *unused)
+{
+	if (tpm_flush_deferred_extends() != TPM_SUCCESS)
+		die("TPM: Failed to extend deferred measurements\n");
+}
+BOOT_STATE_INIT_ENTRY(BS_OS_RESUME, BS_ON_ENTRY, tpm_flush_on_resume, NULL);
+#endif
+
 #if CONFIG(VBOOT_LIB)
 uint32_t tpm_measure_region(const struct region_device *rdev, uint8_t pcr,
 			    const char *rname)
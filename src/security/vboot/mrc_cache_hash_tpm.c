@@ -7,6 +7,7 @@
 #include <security/tpm/tss.h>
 #include <fsp/memory_init.h>
 #include <console/console.h>
+#include <mrc_cache.h>
 #include <string.h>
 
 void mrc_cache_update_hash(const uint8_t *data, size_t size)
@@ -63,14 +64,19 @@ int mrc_cache_verify_hash(const uint8_t *data, size_t size)
 {
 	uint8_t data_hash[VB2_SHA256_DIGEST_SIZE];
 	uint8_t tpm_hash[VB2_SHA256_DIGEST_SIZE];
+	const uint8_t *cached_hash;
 
 	/* We do not store normal mode data hash in TPM. */
 	if (!vboot_recovery_mode_enabled())
 		return 1;
 
-	/* Calculate hash of data read from RECOVERY_MRC_CACHE. */
-	if (vb2_digest_buffer(data, size, VB2_HASH_SHA256, data_hash,
-			      sizeof(data_hash))) {
+	/* Calculate hash of data read from RECOVERY_MRC_CACHE, unless it
+	 * was already computed while validating the data. */
+	cached_hash = mrc_cache_data_sha256(data, size);
+	if (cached_hash) {
+		memcpy(data_hash, cached_hash, sizeof(data_hash));
+	} else if (vb2_digest_buffer(data, size, VB2_HASH_SHA256, data_hash,
+				     sizeof(data_hash))) {
 		printk(BIOS_ERR, "MRC: SHA-256 calculation failed for data.\n");
 		return 0;
 	}
@@ -281,19 +281,19 @@ static void generate_c_state_entries(void)
 
 void generate_p_state_entries(int core, int cores_per_package)
 {
+	/*
+	 * _PSS is the same for every core. It is generated once from the
+	 * MSRs and the AML of the first core is replayed for the others.
+	 */
+	static const char *pss_template;
+	static size_t pss_template_len;
 	int ratio_min, ratio_max, ratio_turbo, ratio_step;
 	int coord_type, power_max, num_entries;
 	int ratio, power, clock, clock_max;
 	bool turbo;
+	char *pss_start;
 
 	coord_type = cpu_get_coord_type();
-	ratio_min = cpu_get_min_ratio();
-	ratio_max = cpu_get_max_ratio();
-	clock_max = (ratio_max * cpu_get_bus_clock()) / KHz;
-	turbo = (get_turbo_state() == TURBO_ENABLED);
-
-	/* Calculate CPU TDP in mW */
-	power_max = cpu_get_power_max();
 
 	/* Write _PCT indicating use of FFixedHW */
 	acpigen_write_empty_PCT();
@@ -303,7 +303,21 @@ void generate_p_state_entries(int core, int cores_per_package)
 	/* Write PSD indicating configured coordination type */
 	acpigen_write_PSD_package(core, 1, coord_type);
 
+	if (pss_template) {
+		acpigen_emit_stream(pss_template, pss_template_len);
+		return;
+	}
+
+	ratio_min = cpu_get_min_ratio();
+	ratio_max = cpu_get_max_ratio();
+	clock_max = (ratio_max * cpu_get_bus_clock()) / KHz;
+	turbo = (get_turbo_state() == TURBO_ENABLED);
+
+	/* Calculate CPU TDP in mW */
+	power_max = cpu_get_power_max();
+
 	/* Add P-state entries in _PSS table */
+	pss_start = acpigen_get_current();
 	acpigen_write_name("_PSS");
 
 	/* Determine ratio points */
@@ -361,6 +375,9 @@ void generate_p_state_entries(int core, int cores_per_package)
 	}
 	/* Fix package length */
 	acpigen_pop_len();
+
+	pss_template = pss_start;
+	pss_template_len = acpigen_get_current() - pss_start;
 }
 
 __attribute__ ((weak)) acpi_tstate_t *soc_get_tss_table(int *entries)
@@ -5,6 +5,7 @@
 #include <console/console.h>
 #include <cpu/x86/lapic.h>
 #include <device/pci.h>
+#include <device/pciexp.h>
 #include <fsp/api.h>
 #include <intelblocks/p2sb.h>
 #include <post.h>
@@ -106,6 +107,7 @@ static void xeonsp_cpx_pci_domain_scan_bus(struct device *dev)
 			for (d = link->children; d; d = d->sibling)
 				pci_probe_dev(d, link, d->path.pci.devfn);
 			scan_bridges(link);
+			pciexp_wait_for_links(link);
 		} else {
 			pci_scan_bus(link, PCI_DEVFN(0, 0), 0xff);
 		}
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <post.h>
 #include <device/pci.h>
+#include <device/pciexp.h>
 #include <soc/acpi.h>
 #include <soc/ramstage.h>
 #include <soc/soc_util.h>
@@ -36,6 +37,7 @@ static void xeonsp_pci_domain_scan_bus(struct device *dev)
 			for (d = link->children; d; d = d->sibling)
 				pci_probe_dev(d, link, d->path.pci.devfn);
 			scan_bridges(link);
+			pciexp_wait_for_links(link);
 		} else {
 			pci_scan_bus(link, PCI_DEVFN(0, 0), 0xff);
 		}
@@ -0,0 +1,259 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <commonlib/helpers.h>
+#include <cpu/x86/mtrr.h>
+#include <memrange.h>
+#include <string.h>
+#include <tests/test.h>
+
+#include "var_mtrr.h"
+
+#define ADDRESS_BITS 39
+
+/* Ten variable MTRRs like on most Intel CPUs, two of them left to the OS. */
+int total_mtrrs = 10;
+int bios_mtrrs = 8;
+
+/* memranges_add_resources() is not exercised here. */
+void search_global_resources(unsigned long type_mask, unsigned long type,
+			     resource_search_t search, void *gp)
+{
+}
+
+struct map_range {
+	resource_t base;
+	resource_t size;
+	unsigned long type;
+};
+
+struct board_map {
+	const char *name;
+	struct map_range ranges[8];
+	/* Variable MTRRs the solver is expected to use for this map. */
+	int num_used;
+};
+
+#define WB MTRR_TYPE_WRBACK
+#define UC MTRR_TYPE_UNCACHEABLE
+#define WC MTRR_TYPE_WRCOMB
+
+/*
+ * Address spaces as get_physical_address_space() would collect them on typical
+ * boards: DRAM as WB, reserved DRAM (TSEG, graphics stolen memory, UMA) as UC
+ * and a prefetchable framebuffer BAR as WC. Later ranges override earlier ones.
+ */
+static const struct board_map board_maps[] = {
+	{
+		.name = "Intel client, 8GiB, IGD",
+		.ranges = {
+			{ 0, 0x8f800000, WB },
+			{ 0x89800000, 0x06000000, UC },
+			{ 0xc0000000, 0x10000000, WC },
+			{ 0x100000000, 0x16f800000, WB },
+		},
+		.num_used = 7,
+	},
+	{
+		.name = "Intel desktop, 16GiB, IGD",
+		.ranges = {
+			{ 0, 0xaf000000, WB },
+			{ 0xaa800000, 0x04800000, UC },
+			{ 0xe0000000, 0x10000000, WC },
+			{ 0x100000000, 0x350800000, WB },
+		},
+		.num_used = 7,
+	},
+	{
+		.name = "AMD APU, 4GiB, UMA",
+		.ranges = {
+			{ 0, 0x80000000, WB },
+			{ 0x5f000000, 0x21000000, UC },
+			{ 0xe0000000, 0x10000000, WC },
+			{ 0x100000000, 0x80000000, WB },
+		},
+		.num_used = 5,
+	},
+	{
+		.name = "QEMU Q35, 2GiB",
+		.ranges = {
+			{ 0, 0x80000000, WB },
+			{ 0x7f000000, 0x01000000, UC },
+			{ 0xfd000000, 0x01000000, WC },
+		},
+		.num_used = 3,
+	},
+	{
+		.name = "Server, 64GiB, 64-bit GPU BAR",
+		.ranges = {
+			{ 0, 0x80000000, WB },
+			{ 0x7c000000, 0x04000000, UC },
+			{ 0x100000000, 0xf80000000, WB },
+			{ 0x6000000000, 0x10000000, WC },
+		},
+		.num_used = 3,
+	},
+};
+
+static void build_map(struct memranges *ranges, const struct map_range *map, size_t num)
+{
+	size_t i;
+
+	memranges_init_empty(ranges, NULL, 0);
+	for (i = 0; i < num && map[i].size; i++)
+		memranges_insert(ranges, map[i].base, map[i].size, map[i].type);
+
+	/* Like get_physical_address_space(), cover everything below 4GiB. */
+	memranges_fill_holes_up_to(ranges, RANGE_TO_PHYS_ADDR(RANGE_4GB), UC);
+}
+
+/* Memory type the programmed variable MTRRs give to `addr`. */
+static int effective_type(const struct var_mtrr_solution *sol, resource_t addr)
+{
+	int i, type, hit = 0, wb = 0, wt = 0, uc = 0, other = -1;
+
+	for (i = 0; i < sol->num_used; i++) {
+		const resource_t base = (resource_t)sol->regs[i].base.hi << 32 |
+					(sol->regs[i].base.lo & ~0xfff);
+		const resource_t mask = (resource_t)sol->regs[i].mask.hi << 32 |
+					(sol->regs[i].mask.lo & ~0xfff);
+
+		assert_true(sol->regs[i].mask.lo & MTRR_PHYS_MASK_VALID);
+		if ((addr & mask) != (base & mask))
+			continue;
+
+		hit = 1;
+		type = sol->regs[i].base.lo & 0xff;
+		if (type == UC)
+			uc = 1;
+		else if (type == WB)
+			wb = 1;
+		else if (type == MTRR_TYPE_WRTHROUGH)
+			wt = 1;
+		else if (other < 0 || other == type)
+			other = type;
+		else
+			return -1;
+	}
+
+	/* UC always wins, WB and WT combine to WT, anything else may not overlap. */
+	if (!hit)
+		return sol->mtrr_default_type;
+	if (uc)
+		return UC;
+	if (other >= 0)
+		return (wb || wt) ? -1 : other;
+	return wt ? MTRR_TYPE_WRTHROUGH : WB;
+}
+
+/* Check the first, the last and a middle page of every range above 1MiB. */
+static void check_solution(struct memranges *ranges, const struct var_mtrr_solution *sol)
+{
+	const struct range_entry *r;
+	resource_t addr[3];
+	size_t i;
+
+	assert_true(sol->num_used <= total_mtrrs);
+
+	memranges_each_entry(r, ranges) {
+		addr[0] = range_entry_base(r);
+		addr[1] = range_entry_end(r) - 4 * KiB;
+		addr[2] = ALIGN_DOWN(range_entry_base(r) + range_entry_size(r) / 2, 4 * KiB);
+
+		for (i = 0; i < ARRAY_SIZE(addr); i++) {
+			/* The fixed MTRRs take precedence below 1MiB. */
+			if (addr[i] < 1 * MiB)
+				continue;
+			assert_int_equal(effective_type(sol, addr[i]), range_entry_tag(r));
+		}
+	}
+}
+
+static void solve(struct memranges *ranges, struct var_mtrr_solution *sol)
+{
+	memset(sol, 0, sizeof(*sol));
+	sol->mtrr_default_type = calc_var_mtrrs(ranges, 1, ADDRESS_BITS);
+	prepare_var_mtrrs(ranges, sol->mtrr_default_type, 1, ADDRESS_BITS, sol);
+}
+
+static void test_mtrr_board_maps(void **state)
+{
+	struct var_mtrr_solution sol;
+	struct memranges ranges;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(board_maps); i++) {
+		build_map(&ranges, board_maps[i].ranges, ARRAY_SIZE(board_maps[i].ranges));
+		solve(&ranges, &sol);
+		check_solution(&ranges, &sol);
+		assert_int_equal(sol.num_used, board_maps[i].num_used);
+		memranges_teardown(&ranges);
+	}
+}
+
+static uint64_t xorshift64(uint64_t *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	return *seed;
+}
+
+/* Random variations of the board maps above, with unaligned DRAM ends and holes. */
+static void test_mtrr_random_maps(void **state)
+{
+	uint64_t seed = 88172645463325252ULL;
+	struct var_mtrr_solution sol;
+	struct memranges ranges;
+	struct map_range map[6];
+	resource_t tolud, size;
+	int n;
+
+	for (n = 0; n < 5000; n++) {
+		memset(map, 0, sizeof(map));
+
+		tolud = (512 + xorshift64(&seed) % 2560) * MiB;
+		map[0] = (struct map_range){ 0, tolud, WB };
+
+		/* TSEG and stolen memory at the top of DRAM. */
+		size = 1ULL << (xorshift64(&seed) % 6 + 22);
+		map[1] = (struct map_range){ tolud - size, size, UC };
+
+		/* UMA or other reserved memory in the middle of DRAM. */
+		if (xorshift64(&seed) % 2) {
+			size = 1ULL << (xorshift64(&seed) % 6 + 20);
+			map[2] = (struct map_range){ ALIGN_DOWN(tolud / 2, size), size, UC };
+		}
+
+		if (xorshift64(&seed) % 2)
+			map[3] = (struct map_range){ 0xe0000000, 0x10000000, WC };
+
+		/* Remapped DRAM above 4GiB, possibly not starting at 4GiB. */
+		if (xorshift64(&seed) % 4) {
+			resource_t base = 4ULL * GiB + (xorshift64(&seed) % 4) * 16 * MiB;
+
+			size = (1 + xorshift64(&seed) % (64 * KiB)) * MiB;
+			map[4] = (struct map_range){ base, size, WB };
+		}
+
+		if (xorshift64(&seed) % 4 == 0)
+			map[5] = (struct map_range){ 0x6000000000 + (xorshift64(&seed) % 64) * 256 * MiB,
+						     256 * MiB, WC };
+
+		build_map(&ranges, map, ARRAY_SIZE(map));
+		solve(&ranges, &sol);
+		/* Maps that need more MTRRs than available are not checked. */
+		if (sol.num_used <= total_mtrrs)
+			check_solution(&ranges, &sol);
+		memranges_teardown(&ranges);
+	}
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_mtrr_board_maps),
+		cmocka_unit_test(test_mtrr_random_maps),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
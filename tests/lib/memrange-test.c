@@ -0,0 +1,292 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+
+#include <memrange.h>
+#include <stdlib.h>
+#include <tests/test.h>
+
+enum mem_types {
+	CACHEABLE_TAG = 1,
+	RESERVED_TAG,
+	READONLY_TAG,
+};
+
+/* memranges_add_resources() is not exercised here. */
+void search_global_resources(unsigned long type_mask, unsigned long type,
+			     resource_search_t search, void *gp)
+{
+}
+
+static void check_entry(const struct range_entry *r, resource_t base, resource_t end,
+			unsigned long tag)
+{
+	assert_non_null(r);
+	assert_int_equal(range_entry_base(r), base);
+	assert_int_equal(range_entry_end(r), end);
+	assert_int_equal(range_entry_tag(r), tag);
+}
+
+static size_t count_entries(struct memranges *ranges)
+{
+	const struct range_entry *r;
+	size_t count = 0;
+
+	memranges_each_entry(r, ranges)
+		count++;
+
+	return count;
+}
+
+/* Entries must be sorted, must not overlap and same tag neighbors must be merged. */
+static void check_invariants(struct memranges *ranges)
+{
+	const struct range_entry *r;
+	const struct range_entry *prev = NULL;
+
+	memranges_each_entry(r, ranges) {
+		assert_true(range_entry_base(r) < range_entry_end(r));
+		if (prev != NULL) {
+			assert_true(range_entry_end(prev) <= range_entry_base(r));
+			if (range_entry_end(prev) == range_entry_base(r))
+				assert_int_not_equal(range_entry_tag(prev), range_entry_tag(r));
+			assert_ptr_equal(memranges_next_entry(ranges, prev), r);
+		}
+		prev = r;
+	}
+
+	if (prev != NULL)
+		assert_null(memranges_next_entry(ranges, prev));
+}
+
+static void test_memrange_insert(void **state)
+{
+	struct memranges ranges;
+	const struct range_entry *r;
+
+	memranges_init_empty(&ranges, NULL, 0);
+	assert_true(memranges_is_empty(&ranges));
+
+	memranges_insert(&ranges, 0x10000, 0x10000, CACHEABLE_TAG);
+	memranges_insert(&ranges, 0x40000, 0x10000, CACHEABLE_TAG);
+	memranges_insert(&ranges, 0x30000, 0x10000, RESERVED_TAG);
+	assert_int_equal(count_entries(&ranges), 3);
+	check_invariants(&ranges);
+
+	/* Filling the gap with the same tag merges with the left neighbor. */
+	memranges_insert(&ranges, 0x20000, 0x10000, CACHEABLE_TAG);
+	assert_int_equal(count_entries(&ranges), 3);
+	r = ranges.entries;
+	check_entry(r, 0x10000, 0x30000, CACHEABLE_TAG);
+
+	/* Overwriting the middle merges all three entries. */
+	memranges_insert(&ranges, 0x30000, 0x10000, CACHEABLE_TAG);
+	assert_int_equal(count_entries(&ranges), 1);
+	check_entry(ranges.entries, 0x10000, 0x50000, CACHEABLE_TAG);
+
+	/* Unaligned insertions are aligned to 4KiB. */
+	memranges_insert(&ranges, 0x60010, 0x10, READONLY_TAG);
+	check_entry(memranges_next_entry(&ranges, ranges.entries), 0x60000, 0x61000,
+		    READONLY_TAG);
+	check_invariants(&ranges);
+
+	memranges_teardown(&ranges);
+	assert_true(memranges_is_empty(&ranges));
+}
+
+static void test_memrange_create_hole(void **state)
+{
+	struct memranges ranges;
+	const struct range_entry *r;
+
+	memranges_init_empty(&ranges, NULL, 0);
+	memranges_insert(&ranges, 0x10000, 0x40000, CACHEABLE_TAG);
+	memranges_insert(&ranges, 0x60000, 0x10000, RESERVED_TAG);
+
+	/* Hole in the middle of an entry splits it. */
+	memranges_create_hole(&ranges, 0x20000, 0x10000);
+	assert_int_equal(count_entries(&ranges), 3);
+	r = ranges.entries;
+	check_entry(r, 0x10000, 0x20000, CACHEABLE_TAG);
+	r = memranges_next_entry(&ranges, r);
+	check_entry(r, 0x30000, 0x50000, CACHEABLE_TAG);
+
+	/* Hole spanning several entries trims both ends and drops the middle. */
+	memranges_create_hole(&ranges, 0x18000, 0x4c000);
+	assert_int_equal(count_entries(&ranges), 2);
+	r = ranges.entries;
+	check_entry(r, 0x10000, 0x18000, CACHEABLE_TAG);
+	r = memranges_next_entry(&ranges, r);
+	check_entry(r, 0x64000, 0x70000, RESERVED_TAG);
+
+	/* Hole outside of all entries changes nothing. */
+	memranges_create_hole(&ranges, 0x80000, 0x10000);
+	assert_int_equal(count_entries(&ranges), 2);
+	check_invariants(&ranges);
+
+	memranges_teardown(&ranges);
+}
+
+static void test_memrange_update_tag_and_fill(void **state)
+{
+	struct memranges ranges;
+	const struct range_entry *r;
+
+	memranges_init_empty(&ranges, NULL, 0);
+	memranges_insert(&ranges, 0x10000, 0x10000, CACHEABLE_TAG);
+	memranges_insert(&ranges, 0x20000, 0x10000, RESERVED_TAG);
+	memranges_insert(&ranges, 0x50000, 0x10000, CACHEABLE_TAG);
+
+	memranges_update_tag(&ranges, RESERVED_TAG, CACHEABLE_TAG);
+	assert_int_equal(count_entries(&ranges), 2);
+	check_entry(ranges.entries, 0x10000, 0x30000, CACHEABLE_TAG);
+
+	/* Holes below the limit get filled, the first entry is not extended down. */
+	memranges_fill_holes_up_to(&ranges, 0x80000, READONLY_TAG);
+	assert_int_equal(count_entries(&ranges), 4);
+	r = memranges_next_entry(&ranges, ranges.entries);
+	check_entry(r, 0x30000, 0x50000, READONLY_TAG);
+	r = memranges_next_entry(&ranges, memranges_next_entry(&ranges, r));
+	check_entry(r, 0x60000, 0x80000, READONLY_TAG);
+	check_invariants(&ranges);
+
+	memranges_teardown(&ranges);
+}
+
+static void test_memrange_steal(void **state)
+{
+	struct memranges ranges;
+	resource_t stolen;
+
+	memranges_init_empty(&ranges, NULL, 0);
+	memranges_insert(&ranges, 0x10000, 0x10000, RESERVED_TAG);
+	memranges_insert(&ranges, 0x21000, 0x3f000, CACHEABLE_TAG);
+
+	assert_true(memranges_steal(&ranges, 0xfffff, 0x10000, 16, CACHEABLE_TAG,
+				    MEMRANGES_FIRST_FIT, &stolen));
+	assert_int_equal(stolen, 0x30000);
+	assert_int_equal(count_entries(&ranges), 3);
+
+	/* Nothing below the limit is big enough. */
+	assert_false(memranges_steal(&ranges, 0x2ffff, 0x10000, 12, CACHEABLE_TAG,
+				     MEMRANGES_FIRST_FIT, &stolen));
+	check_invariants(&ranges);
+
+	memranges_teardown(&ranges);
+}
+
+static void test_memrange_steal_best_fit(void **state)
+{
+	struct memranges ranges;
+	resource_t stolen;
+
+	memranges_init_empty(&ranges, NULL, 0);
+	memranges_insert(&ranges, 0x100000, 0x100000, CACHEABLE_TAG);
+	memranges_insert(&ranges, 0x300000, 0x20000, CACHEABLE_TAG);
+	memranges_insert(&ranges, 0x400000, 0x10000, CACHEABLE_TAG);
+
+	/* First fit takes the low, large range. */
+	assert_true(memranges_steal(&ranges, 0xffffffff, 0x10000, 16, CACHEABLE_TAG,
+				    MEMRANGES_FIRST_FIT, &stolen));
+	assert_int_equal(stolen, 0x100000);
+
+	/* Best fit uses the range that fits exactly. */
+	assert_true(memranges_steal(&ranges, 0xffffffff, 0x10000, 16, CACHEABLE_TAG,
+				    MEMRANGES_BEST_FIT, &stolen));
+	assert_int_equal(stolen, 0x400000);
+
+	/* Then the smaller of the two remaining ranges. */
+	assert_true(memranges_steal(&ranges, 0xffffffff, 0x10000, 16, CACHEABLE_TAG,
+				    MEMRANGES_BEST_FIT, &stolen));
+	assert_int_equal(stolen, 0x300000);
+
+	/* Ranges ending above the limit are not considered. */
+	assert_false(memranges_steal(&ranges, 0x10ffff, 0x20000, 16, CACHEABLE_TAG,
+				     MEMRANGES_BEST_FIT, &stolen));
+	check_invariants(&ranges);
+
+	memranges_teardown(&ranges);
+}
+
+static void test_memrange_clone_and_storage(void **state)
+{
+	struct memranges ranges;
+	struct memranges clone;
+	struct range_entry storage[2];
+	const struct range_entry *r;
+	const struct range_entry *c;
+	int i;
+
+	/* Caller provided storage is used first and outgrown as needed. */
+	memranges_init_empty(&ranges, storage, ARRAY_SIZE(storage));
+	memranges_insert(&ranges, 0x10000, 0x1000, CACHEABLE_TAG);
+	assert_ptr_equal(ranges.entries, &storage[0]);
+	for (i = 1; i < 32; i++)
+		memranges_insert(&ranges, 0x10000 + i * 0x2000, 0x1000, CACHEABLE_TAG);
+	assert_int_equal(count_entries(&ranges), 32);
+	check_invariants(&ranges);
+
+	memranges_clone(&clone, &ranges);
+	assert_int_equal(count_entries(&clone), 32);
+	c = clone.entries;
+	memranges_each_entry(r, &ranges) {
+		check_entry(c, range_entry_base(r), range_entry_end(r), range_entry_tag(r));
+		c = memranges_next_entry(&clone, c);
+	}
+
+	memranges_teardown(&ranges);
+	memranges_teardown(&clone);
+	assert_true(memranges_is_empty(&clone));
+}
+
+/* Build and tear down maps with thousands of ranges, like large multi-socket systems. */
+static void test_memrange_many_ranges(void **state)
+{
+	const size_t num_ranges = 4096;
+	struct memranges ranges;
+	const struct range_entry *r;
+	size_t i;
+
+	memranges_init_empty(&ranges, NULL, 0);
+
+	/* Insert in an order that is neither ascending nor descending. */
+	for (i = 0; i < num_ranges; i++) {
+		size_t slot = (i * 2654435761u) % num_ranges;
+
+		memranges_insert(&ranges, (resource_t)slot << 20, 1 << 16,
+				 slot % 2 ? CACHEABLE_TAG : RESERVED_TAG);
+	}
+	assert_int_equal(count_entries(&ranges), num_ranges);
+	check_invariants(&ranges);
+
+	/* Punch holes into every other range. */
+	for (i = 0; i < num_ranges; i += 2)
+		memranges_create_hole(&ranges, ((resource_t)i << 20) + 0x4000, 0x4000);
+	assert_int_equal(count_entries(&ranges), num_ranges + num_ranges / 2);
+	check_invariants(&ranges);
+
+	/* Filling all gaps with a single tag leaves alternating tags behind. */
+	memranges_fill_holes_up_to(&ranges, (resource_t)num_ranges << 20, READONLY_TAG);
+	check_invariants(&ranges);
+	r = ranges.entries;
+	check_entry(r, 0, 0x4000, RESERVED_TAG);
+
+	for (i = 0; i < num_ranges; i++)
+		memranges_create_hole(&ranges, (resource_t)i << 20, 1 << 20);
+	assert_true(memranges_is_empty(&ranges));
+
+	memranges_teardown(&ranges);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_memrange_insert),
+		cmocka_unit_test(test_memrange_create_hole),
+		cmocka_unit_test(test_memrange_update_tag_and_fill),
+		cmocka_unit_test(test_memrange_steal),
+		cmocka_unit_test(test_memrange_steal_best_fit),
+		cmocka_unit_test(test_memrange_clone_and_storage),
+		cmocka_unit_test(test_memrange_many_ranges),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
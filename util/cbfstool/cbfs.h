@@ -94,6 +94,7 @@ struct cbfs_file_attribute {
 #define CBFS_FILE_ATTR_TAG_ALIGNMENT 0x42434c41 /* ALCB */
 #define CBFS_FILE_ATTR_TAG_PADDING 0x47444150 /* PDNG */
 #define CBFS_FILE_ATTR_TAG_IBB 0x32494242 /* Initial BootBlock */
+#define CBFS_FILE_ATTR_TAG_INPLACE 0x42435049 /* IPCB */
 
 struct cbfs_file_attr_compression {
 	uint32_t tag;
@@ -123,6 +124,13 @@ struct cbfs_file_attr_align {
 	uint32_t alignment;
 } __packed;
 
+struct cbfs_file_attr_inplace {
+	uint32_t tag;
+	uint32_t len;
+	uint32_t decompressed_size;
+	uint32_t margin;
+} __packed;
+
 struct cbfs_stage {
 	uint32_t compression;
 	uint64_t entry;
@@ -9,8 +9,9 @@
 
 #include "common.h"
 
-const char *usage_text = "cbfs-compression-tool benchmark\n"
-	"  runs benchmarks for all implemented algorithms\n"
+const char *usage_text = "cbfs-compression-tool benchmark [inFile...]\n"
+	"  runs benchmarks for all implemented algorithms, optionally\n"
+	"  measuring decompression throughput over the given files\n"
 	"cbfs-compression-tool compress inFile outFile algo\n"
 	"  compresses inFile with algo and stores in outFile\n"
 	"\n"
@@ -24,53 +25,147 @@ static void usage(void)
 	puts(usage_text);
 }
 
-static int benchmark(void)
+static long elapsed_us(const struct timespec *t_s, const struct timespec *t_e)
 {
-	const int bufsize = 10*1024*1024;
-	char *data = malloc(bufsize);
-	if (!data) {
-		fprintf(stderr, "out of memory\n");
-		return 1;
-	}
+	return (t_e->tv_sec - t_s->tv_sec) * 1000000L +
+		(t_e->tv_nsec - t_s->tv_nsec) / 1000L;
+}
+
+/*
+ * Compress data with every algorithm and then decompress it again
+ * repeatedly, so that the decoders that run at boot time can be compared
+ * on real stage and payload images.
+ */
+static int benchmark_data(const char *name, char *data, int bufsize)
+{
+	const int decomp_rounds = 16;
+	int ret = 1;
 	char *compressed_data = malloc(bufsize);
-	if (!compressed_data) {
-		free(data);
+	char *decompressed_data = malloc(bufsize);
+	if (!compressed_data || !decompressed_data) {
 		fprintf(stderr, "out of memory\n");
-		return 1;
-	}
-	int i, l = strlen(usage_text) + 1;
-	for (i = 0; i + l < bufsize; i += l) {
-		memcpy(data + i, usage_text, l);
+		goto out;
 	}
-	memset(data + i, 0, bufsize - i);
+
+	printf("benchmarking '%s' (%d bytes)\n", name, bufsize);
 	const struct typedesc_t *algo;
 	for (algo = &types_cbfs_compression[0]; algo->name != NULL; algo++) {
 		int outsize = bufsize;
+		size_t actual_size = 0;
 		printf("measuring '%s'\n", algo->name);
 		comp_func_ptr comp = compression_function(algo->type);
-		if (comp == NULL) {
+		decomp_func_ptr decomp = decompression_function(algo->type);
+		if (comp == NULL || decomp == NULL) {
 			printf("no handler associated with algorithm\n");
-			free(data);
-			free(compressed_data);
-			return 1;
+			goto out;
 		}
 
 		struct timespec t_s, t_e;
 		clock_gettime(CLOCK_MONOTONIC, &t_s);
 
 		if (comp(data, bufsize, compressed_data, &outsize)) {
-			printf("compression failed");
-			return 1;
+			/* Incompressible input, nothing to decode either. */
+			printf("compression failed\n");
+			continue;
 		}
 
 		clock_gettime(CLOCK_MONOTONIC, &t_e);
 		printf("compressing %d bytes to %d took %ld seconds\n",
 			bufsize, outsize,
 			(long)(t_e.tv_sec - t_s.tv_sec));
+
+		clock_gettime(CLOCK_MONOTONIC, &t_s);
+		for (int i = 0; i < decomp_rounds; i++) {
+			if (decomp(compressed_data, outsize, decompressed_data,
+				   bufsize, &actual_size) ||
+			    actual_size != (size_t)bufsize) {
+				printf("decompression failed\n");
+				goto out;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &t_e);
+
+		if (memcmp(data, decompressed_data, bufsize)) {
+			printf("decompressed data does not match input\n");
+			goto out;
+		}
+
+		long us = elapsed_us(&t_s, &t_e) / decomp_rounds;
+		printf("decompressing %d bytes took %ld us (%ld MiB/s)\n",
+			outsize, us,
+			us ? (long)((long long)bufsize * 1000000 / us / MiB) : 0);
 	}
-	free(data);
+
+	ret = 0;
+out:
 	free(compressed_data);
-	return 0;
+	free(decompressed_data);
+	return ret;
+}
+
+static int benchmark_file(const char *filename)
+{
+	int ret = 1;
+	char *data = NULL;
+	FILE *fin = fopen(filename, "rb");
+	if (!fin) {
+		fprintf(stderr, "could not open '%s'\n", filename);
+		return 1;
+	}
+
+	if (fseek(fin, 0, SEEK_END) != 0) {
+		fprintf(stderr, "could not seek in input\n");
+		goto out;
+	}
+	long insize = ftell(fin);
+	if (insize <= 0) {
+		fprintf(stderr, "could not determine input size\n");
+		goto out;
+	}
+	rewind(fin);
+
+	data = malloc(insize);
+	if (!data) {
+		fprintf(stderr, "out of memory\n");
+		goto out;
+	}
+	if (fread(data, insize, 1, fin) != 1) {
+		fprintf(stderr, "could not read '%s'\n", filename);
+		goto out;
+	}
+
+	ret = benchmark_data(filename, data, insize);
+out:
+	fclose(fin);
+	free(data);
+	return ret;
+}
+
+static int benchmark(int argc, char **argv)
+{
+	const int bufsize = 10*1024*1024;
+	int ret;
+
+	if (argc > 0) {
+		for (int i = 0; i < argc; i++)
+			if (benchmark_file(argv[i]))
+				return 1;
+		return 0;
+	}
+
+	char *data = malloc(bufsize);
+	if (!data) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	int i, l = strlen(usage_text) + 1;
+	for (i = 0; i + l < bufsize; i += l) {
+		memcpy(data + i, usage_text, l);
+	}
+	memset(data + i, 0, bufsize - i);
+	ret = benchmark_data("generated text", data, bufsize);
+	free(data);
+	return ret;
 }
 
 static int compress(char *infile, char *outfile, char *algoname,
@@ -179,8 +274,8 @@ out:
 
 int main(int argc, char **argv)
 {
-	if ((argc == 2) && (strcmp(argv[1], "benchmark") == 0))
-		return benchmark();
+	if ((argc >= 2) && (strcmp(argv[1], "benchmark") == 0))
+		return benchmark(argc - 2, argv + 2);
 	if ((argc == 5) && (strcmp(argv[1], "compress") == 0))
 		return compress(argv[2], argv[3], argv[4], 1);
 	if ((argc == 5) && (strcmp(argv[1], "rawcompress") == 0))
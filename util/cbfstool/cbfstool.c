@@ -733,6 +733,32 @@ static int cbfstool_convert_mkstage(struct buffer *buffer, uint32_t *offset,
 
 	if (ret != 0)
 		return -1;
+
+	/* LZ4 stages are always decompressed in place, for other algorithms
+	   record how much room the loader needs to do the same. */
+	struct buffer stage_header;
+	buffer_splice(&stage_header, &output, 0, sizeof(struct cbfs_stage));
+	uint32_t algo = xdr_le.get32(&stage_header);
+	size_t decompressed_size, margin;
+	if (!param.stage_xip && algo != CBFS_COMPRESS_NONE &&
+	    algo != CBFS_COMPRESS_LZ4 &&
+	    !compression_inplace_margin(algo,
+			output.data + sizeof(struct cbfs_stage),
+			output.size - sizeof(struct cbfs_stage),
+			&decompressed_size, &margin)) {
+		struct cbfs_file_attr_inplace *attrs =
+			(struct cbfs_file_attr_inplace *)
+			cbfs_add_file_attr(header,
+				CBFS_FILE_ATTR_TAG_INPLACE,
+				sizeof(struct cbfs_file_attr_inplace));
+		if (attrs == NULL) {
+			buffer_delete(&output);
+			return -1;
+		}
+		attrs->decompressed_size = htonl(decompressed_size);
+		attrs->margin = htonl(margin);
+	}
+
 	buffer_delete(buffer);
 	// Direct assign, no dupe.
 	memcpy(buffer, &output, sizeof(*buffer));
@@ -151,6 +151,7 @@ enum comp_algo {
 	CBFS_COMPRESS_NONE = 0,
 	CBFS_COMPRESS_LZMA = 1,
 	CBFS_COMPRESS_LZ4 = 2,
+	CBFS_COMPRESS_ZSTD = 3,
 };
 
 struct typedesc_t {
@@ -162,12 +163,21 @@ static const struct typedesc_t types_cbfs_compression[] = {
 	{CBFS_COMPRESS_NONE, "none"},
 	{CBFS_COMPRESS_LZMA, "LZMA"},
 	{CBFS_COMPRESS_LZ4, "LZ4"},
+	{CBFS_COMPRESS_ZSTD, "ZSTD"},
 	{0, NULL},
 };
 
 comp_func_ptr compression_function(enum comp_algo algo);
 decomp_func_ptr decompression_function(enum comp_algo algo);
 
+/* Determine how many bytes a buffer has to extend past the decompressed data
+ * for in_len bytes of compressed data at its very end to be decompressed in
+ * place. Returns 0 on success, -1 on error or if the algorithm doesn't support
+ * in-place decompression.
+ */
+int compression_inplace_margin(enum comp_algo algo, char *in, int in_len,
+			       size_t *decompressed_size, size_t *margin);
+
 uint64_t intfiletype(const char *name);
 
 /* cbfs-mkpayload.c */
@@ -200,6 +210,8 @@ void print_supported_filetypes(void);
 int do_lzma_compress(char *in, int in_len, char *out, int *out_len);
 int do_lzma_uncompress(char *dst, int dst_len, char *src, int src_len,
 			size_t *actual_size);
+int do_lzma_inplace_margin(char *src, int src_len, size_t *out_len,
+			   size_t *margin);
 
 /* xdr.c */
 struct xdr {
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include "common.h"
 #include "lz4/lib/lz4frame.h"
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
 #include <commonlib/bsd/compression.h>
 
 static int lz4_compress(char *in, int in_len, char *out, int *out_len)
@@ -50,6 +52,63 @@ static int lzma_decompress(char *in, int in_len, char *out, unused int out_len,
 {
 	return do_lzma_uncompress(out, out_len, in, in_len, actual_size);
 }
+
+/* The zstd sources shared with coreboot have no default allocator. */
+static void *zstd_alloc(unused void *opaque, size_t size)
+{
+	return malloc(size);
+}
+
+static void zstd_free(unused void *opaque, void *address)
+{
+	free(address);
+}
+
+static int zstd_compress(char *in, int in_len, char *out, int *out_len)
+{
+	size_t worst_size = ZSTD_compressBound(in_len);
+	ZSTD_CCtx *cctx;
+	void *bounce;
+	size_t ret;
+
+	cctx = ZSTD_createCCtx_advanced((ZSTD_customMem){
+		.customAlloc = zstd_alloc,
+		.customFree = zstd_free,
+	});
+	bounce = malloc(worst_size);
+	if (!cctx || !bounce) {
+		ZSTD_freeCCtx(cctx);
+		free(bounce);
+		return -1;
+	}
+	/* The decoder needs no checksum and uses the content size to skip
+	   the window buffer, see uzstdn(). */
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 19);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 0);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 1);
+	ret = ZSTD_compress2(cctx, bounce, worst_size, in, in_len);
+	ZSTD_freeCCtx(cctx);
+	if (ZSTD_isError(ret) || ret >= (size_t)in_len) {
+		free(bounce);
+		return -1;
+	}
+	memcpy(out, bounce, ret);
+	*out_len = ret;
+	free(bounce);
+	return 0;
+}
+
+static int zstd_decompress(char *in, int in_len, char *out, int out_len,
+			   size_t *actual_size)
+{
+	size_t result = uzstdn(in, in_len, out, out_len);
+	if (result == 0)
+		return -1;
+	if (actual_size != NULL)
+		*actual_size = result;
+	return 0;
+}
+
 static int none_compress(char *in, int in_len, char *out, int *out_len)
 {
 	memcpy(out, in, in_len);
@@ -79,6 +138,9 @@ comp_func_ptr compression_function(enum comp_algo algo)
 	case CBFS_COMPRESS_LZ4:
 		compress = lz4_compress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		compress = zstd_compress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
@@ -99,9 +161,65 @@ decomp_func_ptr decompression_function(enum comp_algo algo)
 	case CBFS_COMPRESS_LZ4:
 		decompress = lz4_decompress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		decompress = zstd_decompress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
 	}
 	return decompress;
 }
+
+int compression_inplace_margin(enum comp_algo algo, char *in, int in_len,
+			       size_t *decompressed_size, size_t *margin)
+{
+	decomp_func_ptr decompress = decompression_function(algo);
+	unsigned long long content_size;
+	size_t out_len, buf_size, actual_size;
+	char *ref, *buf;
+	int ret = -1;
+
+	switch (algo) {
+	case CBFS_COMPRESS_LZMA:
+		if (do_lzma_inplace_margin(in, in_len, &out_len, margin))
+			return -1;
+		break;
+	case CBFS_COMPRESS_ZSTD:
+		content_size = ZSTD_getFrameContentSize(in, in_len);
+		if (content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+		    content_size == ZSTD_CONTENTSIZE_ERROR)
+			return -1;
+		out_len = content_size;
+		*margin = ZSTD_decompressionMargin(in, in_len);
+		if (ZSTD_isError(*margin))
+			return -1;
+		break;
+	default:
+		return -1;
+	}
+
+	/* Make sure that decompressing in place really works. */
+	buf_size = out_len + *margin;
+	ref = malloc(out_len);
+	buf = malloc(buf_size);
+	if (!ref || !buf)
+		goto out;
+	if (decompress(in, in_len, ref, out_len, NULL))
+		goto out;
+	memcpy(buf + buf_size - in_len, in, in_len);
+	if (decompress(buf + buf_size - in_len, in_len, buf, buf_size,
+		       &actual_size))
+		goto out;
+	if (actual_size != out_len || memcmp(buf, ref, out_len)) {
+		ERROR("In-place decompression margin BUG! Report to mailing list.\n");
+		goto out;
+	}
+
+	*decompressed_size = out_len;
+	ret = 0;
+out:
+	free(ref);
+	free(buf);
+	return ret;
+}
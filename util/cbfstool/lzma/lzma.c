@@ -190,3 +190,79 @@ int do_lzma_uncompress(char *dst, int dst_len, char *src, int src_len,
 
 	return 0;
 }
+
+/**
+ * Find out how far the end of a buffer must lie past the end of the
+ * decompressed data, so that src can be copied to the end of that buffer and
+ * decompressed in place without overwriting input that wasn't consumed yet.
+ * @param src a pointer to the compressed data
+ * @param src_len the length in bytes
+ * @param out_len a pointer to the decompressed length of src
+ * @param margin a pointer to the number of bytes needed past out_len
+ */
+
+int do_lzma_inplace_margin(char *src, int src_len, size_t *out_len,
+			   size_t *margin)
+{
+	if (src_len <= LZMA_PROPS_SIZE + 8) {
+		ERROR("LZMA: Input length is too small.\n");
+		return -1;
+	}
+
+	uint64_t dst_len = get_64(&src[LZMA_PROPS_SIZE]);
+	uint8_t *dst = malloc(dst_len);
+	if (!dst) {
+		ERROR("Can't allocate memory!\n");
+		return -1;
+	}
+
+	struct CLzmaDec state;
+	LzmaDec_Construct(&state);
+	if (LzmaDec_AllocateProbs(&state, (uint8_t *)src, LZMA_PROPS_SIZE,
+				  &LZMAalloc) != SZ_OK) {
+		ERROR("LZMA: Incorrect stream properties.\n");
+		free(dst);
+		return -1;
+	}
+	state.dic = dst;
+	state.dicBufSize = dst_len;
+	LzmaDec_Init(&state);
+
+	/* Feed the decoder a byte at a time and track by how much the output
+	   position runs ahead of the input position. */
+	size_t in_pos = LZMA_PROPS_SIZE + 8;
+	int64_t lead = -(int64_t)in_pos;
+	int res = SZ_OK;
+	while (state.dicPos < dst_len && in_pos < (size_t)src_len) {
+		enum ELzmaStatus status;
+		size_t len = 1;
+
+		res = LzmaDec_DecodeToDic(&state, dst_len,
+					  (uint8_t *)&src[in_pos], &len,
+					  LZMA_FINISH_ANY, &status);
+		if (res != SZ_OK || len == 0)
+			break;
+		in_pos += len;
+		if ((int64_t)state.dicPos - (int64_t)in_pos > lead)
+			lead = (int64_t)state.dicPos - (int64_t)in_pos;
+	}
+	*out_len = state.dicPos;
+	LzmaDec_FreeProbs(&state, &LZMAalloc);
+	free(dst);
+
+	if (res != SZ_OK || *out_len != dst_len) {
+		ERROR("Error while decompressing.\n");
+		return -1;
+	}
+
+	/* The decoder may hold back up to LZMA_REQUIRED_INPUT_MAX bytes of
+	   input that were already counted above, and other decoders may read
+	   their input in different chunks, so leave generous slack. */
+	lead += 2 * LZMA_REQUIRED_INPUT_MAX;
+	if (lead + src_len < (int64_t)dst_len)
+		*margin = 0;
+	else
+		*margin = lead + src_len - dst_len;
+
+	return 0;
+}
@@ -1120,6 +1120,75 @@ static void expose_device_names(FILE *fil, FILE *head, struct device *ptr, struc
 	}
 }
 
+/*
+ * PCI devices on the root bus, that is the first link of the first domain in
+ * all_devices order, as used by pci_root_bus() in src/device/device_const.c.
+ */
+static struct device *pci_root_domain;
+static struct device **pci_root_devices;
+static int pci_root_device_count;
+
+static void collect_pci_root_devices(FILE *fil, FILE *head, struct device *ptr,
+				     struct device *next)
+{
+	if (!pci_root_domain && ptr->bustype == DOMAIN)
+		pci_root_domain = ptr;
+
+	if (ptr->bustype != PCI || ptr->parent->dev != pci_root_domain ||
+	    ptr->parent->id != 0)
+		return;
+
+	pci_root_devices = realloc(pci_root_devices,
+				   (pci_root_device_count + 1) * sizeof(*pci_root_devices));
+	if (!pci_root_devices) {
+		fprintf(stderr, "%s: Failed to alloc mem!\n", __func__);
+		exit(1);
+	}
+	pci_root_devices[pci_root_device_count++] = ptr;
+}
+
+static int pci_devfn(const struct device *dev)
+{
+	return (dev->path_a << 3) | dev->path_b;
+}
+
+/*
+ * Emit the PCI devices on the root bus sorted by devfn, so that stages with
+ * a constant devicetree can binary search them instead of walking siblings.
+ * Sorting is stable, on duplicate devfns the first sibling is found first
+ * just like when walking the list.
+ */
+static void emit_pci_root_devices(FILE *fil, FILE *head)
+{
+	struct device *dev;
+	int i, j;
+
+	for (i = 1; i < pci_root_device_count; i++) {
+		dev = pci_root_devices[i];
+		for (j = i; j > 0 && pci_devfn(pci_root_devices[j - 1]) > pci_devfn(dev); j--)
+			pci_root_devices[j] = pci_root_devices[j - 1];
+		pci_root_devices[j] = dev;
+	}
+
+	fprintf(head, "extern const size_t __pci_0_device_count;\n");
+	fprintf(head, "extern const u8 __pci_0_devfns[];\n");
+	fprintf(head, "extern DEVTREE_CONST struct device *DEVTREE_CONST __pci_0_devices[];\n");
+
+	fprintf(fil, "const size_t __pci_0_device_count = %d;\n", pci_root_device_count);
+	fprintf(fil, "const u8 __pci_0_devfns[] = {\n");
+	for (i = 0; i < pci_root_device_count; i++)
+		fprintf(fil, "\t0x%02x,\n", pci_devfn(pci_root_devices[i]));
+	if (!pci_root_device_count)
+		fprintf(fil, "\t0\n");
+	fprintf(fil, "};\n");
+	fprintf(fil, "DEVTREE_CONST struct device *DEVTREE_CONST __pci_0_devices[] = {\n");
+	for (i = 0; i < pci_root_device_count; i++)
+		fprintf(fil, "\t&%s,\n", pci_root_devices[i]->name);
+	if (!pci_root_device_count)
+		fprintf(fil, "\tNULL\n");
+	fprintf(fil, "};\n");
+}
+
 static void add_siblings_to_queue(struct queue_entry **bfs_q_head,
 				  struct device *d)
 {
@@ -1644,6 +1713,10 @@ int main(int argc, char **argv)
 	fprintf(autogen, "\n/* expose_device_names */\n");
 	walk_device_tree(autogen, autohead, &base_root_dev, expose_device_names);
 
+	fprintf(autogen, "\n/* pci_root_devices */\n");
+	walk_device_tree(autogen, autohead, &base_root_dev, collect_pci_root_devices);
+	emit_pci_root_devices(autogen, autohead);
+
 	fprintf(autohead, "\n#endif /* __STATIC_DEVICE_TREE_H */\n");
 	fclose(autohead);
 	fclose(autogen);